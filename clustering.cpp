@@ -124,16 +124,141 @@ int main(int argc, char* argv[]) {
                                           "set -T -1 for default values: FROM=0.1, STEP=0.1, TO=MAX_FE.\n"
                                           "parameters may be given partially, e.g.: -T 0.2 0.4 to start at 0.2 and go to MAX_FE at steps 0.4.\n"
                                           "for threshold-screening, --output denotes the basename only. output files will have the"
-                                          " current threshold limit appended to the given filename.")
+                                          " current threshold limit appended to the given filename.\n"
+                                          "without initial states (-i), all thresholds are computed in a single sweep over the frames.")
+    ("screening-engine", b_po::value<std::string>()->default_value("sweep"),
+                                          "parameter: engine for threshold screening (-T) without initial states (-i). one of\n"
+                                          "  sweep: serial merging of the neighborhoods of frames in order of free energy (default).\n"
+                                          "  components: parallel connected components of all frames below the threshold,\n"
+                                          "              linked if closer than the 4*sigma2 distance criterion.\n"
+                                          "results are exactly the same for both engines.")
+    ("screening-checkpoint", b_po::value<std::string>(),
+                                          "output (optional): save the state of the threshold screening (-T) to the given file\n"
+                                          "(see --screening-checkpoint-interval), to resume interrupted runs (see --screening-resume).")
+    ("screening-checkpoint-interval", b_po::value<int>()->default_value(1),
+                                          "parameter: number of thresholds between screening checkpoints (default: 1).\n"
+                                          "the 'sweep' engine restarts its sweep at every checkpoint.")
+    ("screening-resume", b_po::bool_switch()->default_value(false),
+                                          "parameter: resume threshold screening from the checkpoint file (--screening-checkpoint),\n"
+                                          "if it exists. thresholds and data must be the same as for the interrupted run.\n"
+                                          "results are exactly the same as of an uninterrupted run.")
     ("output,o", b_po::value<std::string>(), "output (optional): clustering information.")
     ("input,i", b_po::value<std::string>(), "input (optional): initial state definition.")
     ("radii,R", b_po::value<std::vector<float>>()->multitoken(), "parameter: list of radii for population/free energy calculations "
                                                                  "(i.e. compute populations/free energies for several radii in one go).")
     ("population,p", b_po::value<std::string>(), "output (optional): population per frame (if -R is set: this defines only the basename).")
     ("free-energy,d", b_po::value<std::string>(), "output (optional): free energies per frame (if -R is set: this defines only the basename).")
+    ("population-engine", b_po::value<std::string>()->default_value("boxes"),
+                                          "parameter: engine for population computations. one of\n"
+                                          "  boxes:  box-assisted search on the first --box-dims dimensions (default).\n"
+                                          "  kdtree: k-d tree pruning on all dimensions. much faster for data of\n"
+                                          "          more dimensions than used for the boxes (--box-dims).\n"
+                                          "  profile: box-assisted search (see --box-dims), computing per-frame population profiles\n"
+                                          "           for all radii in a single pass. fastest for scans over many radii (-R).\n"
+                                          "  gemm: tiled distance computation via matrix products on all dimensions.\n"
+                                          "        fastest for high-dimensional data (e.g. 20-50 columns).\n"
+                                          "  lsh: APPROXIMATE populations via locality-sensitive hashing for exploratory\n"
+                                          "       runs on very large data sets. populations may be underestimated, the\n"
+                                          "       estimated relative error is printed (see --lsh-* options).\n"
+                                          "results are exactly the same for all engines but 'lsh'.\n"
+                                          "depending on the build, 'gemm' is chosen by default for data of many columns.")
+    ("nn-engine", b_po::value<std::string>()->default_value("kdtree"),
+                                          "parameter: engine for nearest neighbor computations. one of\n"
+                                          "  kdtree: k-d tree search pruning on all dimensions (default).\n"
+                                          "  incremental: k-d tree search, with neighbors of lower free energy found by\n"
+                                          "               inserting frames into the tree in order of free energy.\n"
+                                          "               fastest if many frames have few neighbors of lower free energy.\n"
+                                          "  gemm: tiled distance computation via matrix products on all dimensions.\n"
+                                          "  hnsw: APPROXIMATE nearest neighbors via a hierarchical navigable small world\n"
+                                          "        graph for very large, high-dimensional data sets. some frames may get\n"
+                                          "        a neighbor that is not the nearest one, the estimated recall is\n"
+                                          "        printed (see --hnsw-* options).\n"
+                                          "  brute:  comparison of all frame pairs, optionally pruned by\n"
+                                          "          --prefilter, --pivots and --partial-distances.\n"
+                                          "results are exactly the same for all engines but 'hnsw'.\n"
+                                          "depending on the build, 'gemm' is chosen by default for data of many columns.")
+    ("box-dims", b_po::value<int>()->default_value(2),
+                                          "parameter: number of dimensions of the box grid used by the 'boxes' and 'profile' population engines,\n"
+                                          "i.e. the first N columns are separated into boxes (default: 2).\n"
+                                          "higher values prune more candidates, but every frame has 3^N neighboring boxes.")
+    ("reorder", b_po::value<std::string>()->default_value("none"),
+                                          "parameter: reorder frames along a space-filling curve before all computations\n"
+                                          "for better cache locality. one of\n"
+                                          "  none, morton, hilbert (default: none).\n"
+                                          "inputs and outputs are kept in original frame order, ties of distances\n"
+                                          "and free energies are decided as without reordering, i.e. results are the same\n"
+                                          "(except for nn-engine 'hnsw').")
+    ("reorder-dims", b_po::value<int>()->default_value(3),
+                                          "parameter: number of leading dimensions spanned by the space-filling curve\n"
+                                          "(default: 3, at most 64).")
+    ("prefilter", b_po::bool_switch()->default_value(false),
+                                          "parameter: decide most frame pairs of population and nearest neighbor computations\n"
+                                          "on 8-bit compressed coordinates, computing full precision distances only for\n"
+                                          "borderline pairs (not used by the 'kdtree' engines). results are exactly the same.")
+    ("pivots", b_po::value<int>()->default_value(0),
+                                          "parameter: number of pivot frames for triangle-inequality pruning of\n"
+                                          "population and nearest neighbor computations on all dimensions\n"
+                                          "(not used by the 'kdtree' engines; default: 0, i.e. no pivots).\n"
+                                          "results are exactly the same.")
+    ("partial-distances", b_po::bool_switch()->default_value(false),
+                                          "parameter: sum up distances of population and nearest neighbor computations\n"
+                                          "over columns in order of decreasing variance and stop as soon as pairs are\n"
+                                          "out of range (not used by the 'kdtree' engines). fast for PCA-like input.\n"
+                                          "results are exactly the same.")
+    ("lsh-tables", b_po::value<int>()->default_value(8),
+                                          "parameter: number of hash tables of the 'lsh' engine (default: 8).\n"
+                                          "more tables find more neighbors at higher cost.")
+    ("lsh-hashes", b_po::value<int>()->default_value(4),
+                                          "parameter: number of random projections per hash table of the 'lsh' engine (default: 4).\n"
+                                          "more projections give smaller buckets, i.e. faster but less accurate results.")
+    ("lsh-width", b_po::value<float>()->default_value(4.0f),
+                                          "parameter: bucket width of the 'lsh' engine, in units of the largest radius (default: 4.0).")
+    ("lsh-samples", b_po::value<int>()->default_value(1000),
+                                          "parameter: number of frames with exact populations to estimate\n"
+                                          "the error of the 'lsh' engine (default: 1000).")
+    ("hnsw-links", b_po::value<int>()->default_value(16),
+                                          "parameter: number of links per frame of the 'hnsw' engine (default: 16).\n"
+                                          "more links give higher recall at higher cost and memory.")
+    ("hnsw-ef-construction", b_po::value<int>()->default_value(100),
+                                          "parameter: beam width of the neighbor search while building the graph\n"
+                                          "of the 'hnsw' engine (default: 100).")
+    ("hnsw-ef", b_po::value<int>()->default_value(64),
+                                          "parameter: beam width of the nearest neighbor search of the 'hnsw' engine (default: 64).\n"
+                                          "larger values give higher recall at higher cost.")
+    ("hnsw-samples", b_po::value<int>()->default_value(1000),
+                                          "parameter: number of frames with exact nearest neighbors to estimate\n"
+                                          "the recall of the 'hnsw' engine (default: 1000).")
+    ("tile-checkpoint", b_po::value<std::string>(),
+                                          "output (optional): basename of checkpoint files of population ('boxes' engine, *.pop)\n"
+                                          "and nearest neighbor ('brute' and 'kdtree' engines, *.nn) computations. frames are\n"
+                                          "processed in tiles (see --tile-size), finished tiles are saved to the checkpoint files.\n"
+                                          "other engines are not checkpointed, the 'gemm' engine is not selected automatically.\n"
+                                          "with MPI, every node saves its rows to its own files (*.pop.<node>, *.nn.<node>).")
+    ("tile-size", b_po::value<int>()->default_value(16384),
+                                          "parameter: number of frames per checkpoint tile (default: 16384).")
+    ("tile-resume", b_po::bool_switch()->default_value(false),
+                                          "parameter: resume population and nearest neighbor computations from existing\n"
+                                          "checkpoint files (--tile-checkpoint), i.e. compute only unfinished tiles.\n"
+                                          "data and parameters must be the same as for the interrupted run.\n"
+                                          "results are exactly the same as of an uninterrupted run.")
+    ("simd", b_po::value<std::string>()->default_value("auto"),
+                                          "parameter: instruction set of the distance kernels. one of\n"
+                                          "  auto, scalar, sse2, avx2, avx512 (default: auto, i.e. the best one supported by the CPU).\n"
+                                          "all choices give exactly the same results.")
     ("free-energy-input,D", b_po::value<std::string>(), "input (optional): reuse free energy info.")
     ("nearest-neighbors,b", b_po::value<std::string>(), "output (optional): nearest neighbor info.")
     ("nearest-neighbors-input,B", b_po::value<std::string>(), "input (optional): reuse nearest neighbor info.")
+    ("neighbor-graph", b_po::value<std::string>(),
+                                          "output (optional): build graph of all frame pairs closer than the cutoff\n"
+                                          "(see --neighbor-graph-cutoff) and save it to the given (binary) file.\n"
+                                          "populations (for radii up to the cutoff), nearest neighbors and the\n"
+                                          "screening (for 2*sigma up to the cutoff) are derived from the graph.\n"
+                                          "results are exactly the same.")
+    ("neighbor-graph-input", b_po::value<std::string>(),
+                                          "input (optional): reuse neighbor graph, instead of building it.\n"
+                                          "the graph must have been built from the same coordinates.")
+    ("neighbor-graph-cutoff", b_po::value<float>(),
+                                          "parameter: cutoff radius of the neighbor graph (default: largest radius of -R or -r).")
     // defaults
     ("nthreads,n", b_po::value<int>()->default_value(0),
                       "number of OpenMP threads. default: 0; i.e. use OMP_NUM_THREADS env-variable.")
@@ -26,14 +26,30 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools.hpp"
 #include "logger.hpp"
 #include "density_clustering.hpp"
+#include "density_clustering_simd.hpp"
+#include "density_clustering_prefilter.hpp"
+#include "density_clustering_partial.hpp"
+#include "density_clustering_pivots.hpp"
+#include "density_clustering_lsh.hpp"
+#include "density_clustering_graph.hpp"
 
 #ifdef USE_CUDA
   #include "density_clustering_cuda.hpp"
 #else
   #include "density_clustering_common.hpp"
+  #include "density_clustering_kdtree.hpp"
+  #include "density_clustering_gemm.hpp"
+  #include "density_clustering_hnsw.hpp"
 #endif
 
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 
 namespace Clustering {
   namespace Density {
@@ -41,66 +57,422 @@ namespace Clustering {
     compute_box_grid(const float* coords,
                      const std::size_t n_rows,
                      const std::size_t n_cols,
-                     const float radius) {
-      // use first and second coordinates, since these usually
-      // correspond to first and second PCs, having highest variance.
-      // if clustering is only in 1 dimension, boxes of higher dimensions
-      // will be kept empty.
-      const int BOX_DIM_1 = 0;
-      const int BOX_DIM_2 = 1;
+                     const float radius,
+                     const std::size_t n_box_dims) {
+      // use the first coordinates, since these usually
+      // correspond to the first PCs, having highest variance.
+      // the number of box dimensions is limited by the number of columns.
+      std::size_t n_dims = std::min(n_box_dims, n_cols);
       BoxGrid grid;
       ASSUME_ALIGNED(coords);
-      // find min/max values for first and second dimension
-      float min_x1=0.0f, max_x1=0.0f, min_x2=0.0f, max_x2=0.0f;
-      min_x1=coords[0*n_cols+BOX_DIM_1];
-      max_x1=coords[0*n_cols+BOX_DIM_1];
-      if (n_cols > 1) {
-        min_x2=coords[0*n_cols+BOX_DIM_2];
-        max_x2=coords[0*n_cols+BOX_DIM_2];
-      }
+      // find min/max values per box dimension
+      std::vector<float> min_x(coords, coords + n_dims);
+      std::vector<float> max_x(coords, coords + n_dims);
       Clustering::logger(std::cout) << "setting up boxes for fast NN search" << std::endl;
       for (std::size_t i=1; i < n_rows; ++i) {
-        min_x1 = std::min(min_x1, coords[i*n_cols+BOX_DIM_1]);
-        max_x1 = std::max(max_x1, coords[i*n_cols+BOX_DIM_1]);
-        if (n_cols > 1) {
-          min_x2 = std::min(min_x2, coords[i*n_cols+BOX_DIM_2]);
-          max_x2 = std::max(max_x2, coords[i*n_cols+BOX_DIM_2]);
+        for (std::size_t d=0; d < n_dims; ++d) {
+          min_x[d] = std::min(min_x[d], coords[i*n_cols+d]);
+          max_x[d] = std::max(max_x[d], coords[i*n_cols+d]);
         }
       }
-      // build 2D grid with boxes for efficient nearest neighbor search
-      grid.n_boxes.push_back((max_x1 - min_x1) / radius + 1);
-      if (n_cols > 1) {
-        grid.n_boxes.push_back((max_x2 - min_x2) / radius + 1);
-      } else {
-        grid.n_boxes.push_back(1);
+      // build n-dimensional grid with boxes for efficient nearest neighbor search
+      std::size_t total_boxes = 1;
+      for (std::size_t d=0; d < n_dims; ++d) {
+        int n_boxes_dim = (max_x[d] - min_x[d]) / radius + 1;
+        if (total_boxes > std::numeric_limits<std::size_t>::max() / n_boxes_dim) {
+          // linear box ids would overflow, use less dimensions
+          Clustering::logger(std::cout) << " too many boxes, limiting grid to "
+                                        << d << " dimensions" << std::endl;
+          n_dims = d;
+          break;
+        }
+        grid.strides.push_back(total_boxes);
+        grid.n_boxes.push_back(n_boxes_dim);
+        total_boxes *= n_boxes_dim;
       }
-      grid.assigned_box.resize(n_rows);
+      grid.n_dims = n_dims;
+      // assign frames to boxes
+      std::vector<int> frame_box_coords(n_rows*n_dims);
+      std::vector<std::size_t> frame_box_ids(n_rows, 0);
       for (std::size_t i=0; i < n_rows; ++i) {
-        int i_box_1=0, i_box_2=0;
-        i_box_1 = (coords[i*n_cols+BOX_DIM_1] - min_x1) / radius;
-        if (n_cols > 1) {
-          i_box_2 = (coords[i*n_cols+BOX_DIM_2] - min_x2) / radius;
+        for (std::size_t d=0; d < n_dims; ++d) {
+          int i_box = (coords[i*n_cols+d] - min_x[d]) / radius;
+          frame_box_coords[i*n_dims+d] = i_box;
+          frame_box_ids[i] += i_box * grid.strides[d];
         }
-        grid.assigned_box[i] = {i_box_1, i_box_2};
-        grid.boxes[grid.assigned_box[i]].push_back(i);
       }
+      // sort frames by box and compress to CSR format
+      grid.frames.resize(n_rows);
+      std::iota(grid.frames.begin(), grid.frames.end(), 0);
+      std::stable_sort(grid.frames.begin()
+                     , grid.frames.end()
+                     , [&](std::size_t i, std::size_t j) -> bool {
+                         return frame_box_ids[i] < frame_box_ids[j];
+                       });
+      grid.assigned_box.resize(n_rows);
+      for (std::size_t p=0; p < n_rows; ++p) {
+        std::size_t i = grid.frames[p];
+        if (p == 0 || frame_box_ids[i] != grid.box_ids.back()) {
+          grid.box_ids.push_back(frame_box_ids[i]);
+          grid.box_offsets.push_back(p);
+          grid.box_coords.insert(grid.box_coords.end()
+                               , &frame_box_coords[i*n_dims]
+                               , &frame_box_coords[i*n_dims] + n_dims);
+        }
+        grid.assigned_box[i] = grid.box_ids.size() - 1;
+      }
+      grid.box_offsets.push_back(n_rows);
+      grid.box_diffs = neighbor_box_diffs(n_dims);
       return grid;
     }
 
-    constexpr Box
-    neighbor_box(const Box center, const int i_neighbor) {
-      return {center[0] + BOX_DIFF[i_neighbor][0]
-            , center[1] + BOX_DIFF[i_neighbor][1]};
+    std::vector<Box>
+    neighbor_box_diffs(const std::size_t n_dims) {
+      std::size_t n_neighbors = 1;
+      for (std::size_t d=0; d < n_dims; ++d) {
+        n_neighbors *= 3;
+      }
+      // enumerate all tuples of {-1, 0, 1} by counting in base 3
+      std::vector<Box> diffs(n_neighbors, Box(n_dims));
+      for (std::size_t i=0; i < n_neighbors; ++i) {
+        std::size_t digits = i;
+        for (std::size_t d=0; d < n_dims; ++d) {
+          diffs[i][d] = (int) (digits % 3) - 1;
+          digits /= 3;
+        }
+      }
+      return diffs;
     }
 
-    bool
-    is_valid_box(const Box box, const BoxGrid& grid) {
-      int i1 = box[0];
-      int i2 = box[1];
-      return ((i1 >= 0)
-           && (i1 < grid.n_boxes[0])
-           && (i2 >= 0)
-           && (i2 < grid.n_boxes[1]));
+    void
+    neighbor_boxes(const BoxGrid& grid,
+                   const std::size_t i_box,
+                   std::vector<std::size_t>& neighbors) {
+      neighbors.clear();
+      const int* center = &grid.box_coords[i_box*grid.n_dims];
+      for (const Box& diff: grid.box_diffs) {
+        // check grid limits and compute linear id of neighbor box
+        bool is_valid_box = true;
+        std::size_t box_id = 0;
+        for (std::size_t d=0; d < grid.n_dims; ++d) {
+          int i_box_dim = center[d] + diff[d];
+          if (i_box_dim < 0 || i_box_dim >= grid.n_boxes[d]) {
+            is_valid_box = false;
+            break;
+          }
+          box_id += i_box_dim * grid.strides[d];
+        }
+        if (is_valid_box) {
+          auto it = std::lower_bound(grid.box_ids.begin()
+                                   , grid.box_ids.end()
+                                   , box_id);
+          if (it != grid.box_ids.end() && *it == box_id) {
+            neighbors.push_back(it - grid.box_ids.begin());
+          }
+        }
+      }
+      std::sort(neighbors.begin(), neighbors.end());
+    }
+
+    std::vector<float>
+    box_sorted_coords(const float* coords,
+                      const std::size_t n_cols,
+                      const BoxGrid& grid) {
+      const std::size_t n_rows = grid.frames.size();
+      std::vector<float> sorted_coords(n_rows*n_cols);
+      for (std::size_t p=0; p < n_rows; ++p) {
+        std::copy(&coords[grid.frames[p]*n_cols]
+                , &coords[grid.frames[p]*n_cols] + n_cols
+                , &sorted_coords[p*n_cols]);
+      }
+      return sorted_coords;
+    }
+
+    namespace {
+      /*!
+       * transform coordinates (b bits each) in n dimensions to the
+       * 'transposed' hilbert index, following
+       * J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004).
+       */
+      void
+      hilbert_transpose(std::vector<uint32_t>& x, const std::size_t n_bits) {
+        const std::size_t n = x.size();
+        const uint32_t m = 1u << (n_bits-1);
+        // inverse undo
+        for (uint32_t q=m; q > 1; q >>= 1) {
+          uint32_t p = q - 1;
+          for (std::size_t i=0; i < n; ++i) {
+            if (x[i] & q) {
+              // invert
+              x[0] ^= p;
+            } else {
+              // exchange
+              uint32_t t = (x[0] ^ x[i]) & p;
+              x[0] ^= t;
+              x[i] ^= t;
+            }
+          }
+        }
+        // gray encode
+        for (std::size_t i=1; i < n; ++i) {
+          x[i] ^= x[i-1];
+        }
+        uint32_t t = 0;
+        for (uint32_t q=m; q > 1; q >>= 1) {
+          if (x[n-1] & q) {
+            t ^= q - 1;
+          }
+        }
+        for (std::size_t i=0; i < n; ++i) {
+          x[i] ^= t;
+        }
+      }
+
+      //! buffers for neighbor candidates of a single frame
+      struct CandidateBuffers {
+        std::vector<std::size_t> frames;
+        std::vector<float> dist2;
+        std::vector<float> approx_dist2;
+        std::vector<float> lower;
+        std::vector<float> upper;
+        std::vector<float> partial_dist2;
+      };
+
+      //! optional filters to decide on frame pairs without computing
+      //! their full precision distances, with their thresholds
+      //! to accept (inside of smallest radius) or reject (outside
+      //! of largest radius) a pair. partial distances only reject pairs.
+      struct PairFilter {
+        const Prefilter::CompressedCoords* cc;
+        float accept_thr;
+        float reject_thr;
+        const Pivots::PivotTable* pt;
+        float pivot_accept_thr;
+        float pivot_reject_thr;
+        const PartialDistances::OrderedCoords* oc;
+        float partial_reject_thr;
+      };
+
+      PairFilter
+      pair_filter(const Prefilter::CompressedCoords* cc,
+                  const Pivots::PivotTable* pt,
+                  const PartialDistances::OrderedCoords* oc,
+                  const float rad2_min,
+                  const float rad2_max) {
+        // inactive filters neither accept nor reject any pair
+        const float inf = std::numeric_limits<float>::infinity();
+        PairFilter filter = {cc, 0.0f, inf, pt, 0.0f, inf, oc, inf};
+        if (cc != nullptr) {
+          filter.accept_thr = Prefilter::accept_threshold(*cc, rad2_min);
+          filter.reject_thr = Prefilter::reject_threshold(*cc, rad2_max);
+        }
+        if (pt != nullptr) {
+          filter.pivot_accept_thr = Pivots::accept_threshold(*pt, rad2_min);
+          filter.pivot_reject_thr = Pivots::reject_threshold(*pt, rad2_max);
+        }
+        if (oc != nullptr) {
+          filter.partial_reject_thr = PartialDistances::reject_threshold(*oc, rad2_max);
+        }
+        return filter;
+      }
+
+      /*!
+       * squared distances of box-sorted frame 'p' to the candidate frames
+       * q_from ... q_from+n_frames-1 (excluding 'p' itself), written to 'buf.dist2'.
+       * returns the number of computed distances.
+       *
+       * with active pair filters, pairs rejected by any filter are skipped,
+       * pairs accepted by any filter are only counted in 'n_inside' and only
+       * the remaining, borderline pairs are computed exactly.
+       * with partial distances, the borderline pairs are rejected early if
+       * possible; the numbers of partially evaluated pairs and of their
+       * evaluated columns are added to 'n_partial' and 'n_partial_cols'.
+       */
+      std::size_t
+      candidate_distances(const float* sorted_coords,
+                          const PairFilter& filter,
+                          const std::size_t n_cols,
+                          const std::size_t p,
+                          const std::size_t q_from,
+                          const std::size_t n_frames,
+                          CandidateBuffers& buf,
+                          std::size_t& n_inside,
+                          std::size_t& n_partial,
+                          std::size_t& n_partial_cols) {
+        if (buf.dist2.size() < n_frames) {
+          buf.frames.resize(n_frames);
+          buf.dist2.resize(n_frames);
+          buf.approx_dist2.resize(n_frames);
+          buf.lower.resize(n_frames);
+          buf.upper.resize(n_frames);
+          buf.partial_dist2.resize(n_frames);
+        }
+        if (filter.cc == nullptr && filter.pt == nullptr && filter.oc == nullptr) {
+          SIMD::squared_distances(&sorted_coords[p*n_cols]
+                                , &sorted_coords[q_from*n_cols]
+                                , n_frames
+                                , n_cols
+                                , buf.dist2.data());
+          if (q_from <= p && p < q_from+n_frames) {
+            // remove reference frame itself
+            std::copy(buf.dist2.begin() + (p-q_from) + 1
+                    , buf.dist2.begin() + n_frames
+                    , buf.dist2.begin() + (p-q_from));
+            return n_frames - 1;
+          }
+          return n_frames;
+        }
+        if (filter.cc != nullptr) {
+          Prefilter::approx_squared_distances(*filter.cc, p, q_from, n_frames, buf.approx_dist2.data());
+        }
+        if (filter.pt != nullptr) {
+          Pivots::distance_bounds(*filter.pt, p, q_from, n_frames, buf.lower.data(), buf.upper.data());
+        }
+        std::size_t n_exact = 0;
+        for (std::size_t q=0; q < n_frames; ++q) {
+          if (q_from+q == p
+           || (filter.cc != nullptr && buf.approx_dist2[q] >= filter.reject_thr)
+           || (filter.pt != nullptr && buf.lower[q] >= filter.pivot_reject_thr)) {
+            continue;
+          }
+          if ((filter.cc != nullptr && buf.approx_dist2[q] < filter.accept_thr)
+           || (filter.pt != nullptr && buf.upper[q] < filter.pivot_accept_thr)) {
+            ++n_inside;
+          } else {
+            buf.frames[n_exact] = q_from+q;
+            ++n_exact;
+          }
+        }
+        if (filter.oc != nullptr) {
+          n_partial += n_exact;
+          n_partial_cols += PartialDistances::partial_squared_distances(*filter.oc
+                                                                      , p
+                                                                      , buf.frames.data()
+                                                                      , n_exact
+                                                                      , filter.partial_reject_thr
+                                                                      , buf.partial_dist2.data());
+          std::size_t n_remaining = 0;
+          for (std::size_t q=0; q < n_exact; ++q) {
+            if (buf.partial_dist2[q] < filter.partial_reject_thr) {
+              buf.frames[n_remaining] = buf.frames[q];
+              ++n_remaining;
+            }
+          }
+          n_exact = n_remaining;
+        }
+        SIMD::squared_distances(&sorted_coords[p*n_cols]
+                              , sorted_coords
+                              , buf.frames.data()
+                              , n_exact
+                              , n_cols
+                              , buf.dist2.data());
+        return n_exact;
+      }
+
+      void
+      log_filter_stats(const std::size_t n_candidates,
+                       const std::size_t n_exact) {
+        Clustering::logger(std::cout) << " pair filters decided "
+                                      << (n_candidates == 0 ? 0.0
+                                                            : 100.0 * (n_candidates - n_exact) / n_candidates)
+                                      << "% of " << n_candidates << " candidate pairs"
+                                      << std::endl;
+      }
+
+      void
+      log_partial_stats(const std::size_t n_partial,
+                        const std::size_t n_partial_cols,
+                        const std::size_t n_cols) {
+        Clustering::logger(std::cout) << " partial distances evaluated "
+                                      << (n_partial == 0 ? 0.0
+                                                         : 100.0 * n_partial_cols / ((double) n_partial * n_cols))
+                                      << "% of dimensions for " << n_partial << " pairs"
+                                      << std::endl;
+      }
+
+      void
+      log_box_grid(const BoxGrid& grid) {
+        Clustering::logger(std::cout) << " box grid: ";
+        for (std::size_t d=0; d < grid.n_boxes.size(); ++d) {
+          Clustering::logger(std::cout) << (d == 0 ? "" : " x ")
+                                        << grid.n_boxes[d];
+        }
+        Clustering::logger(std::cout) << ", "
+                                      << grid.box_ids.size()
+                                      << " non-empty boxes"
+                                      << std::endl;
+      }
+    } // end local namespace
+
+    std::vector<std::size_t>
+    space_filling_curve_order(const float* coords,
+                              const std::size_t n_rows,
+                              const std::size_t n_cols,
+                              const std::string curve,
+                              const std::size_t n_curve_dims) {
+      if (curve != "morton" && curve != "hilbert") {
+        std::cerr << "error: unknown space-filling curve '" << curve << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      // at least one bit per dimension, such that the curve index fits into 64 bits
+      const std::size_t n_dims = std::min({n_curve_dims, n_cols, MAX_CURVE_DIMS});
+      std::vector<std::size_t> order(n_rows);
+      std::iota(order.begin(), order.end(), 0);
+      if (n_rows == 0 || n_dims == 0) {
+        return order;
+      }
+      const std::size_t n_bits = std::min<std::size_t>(21, 64 / n_dims);
+      const float max_cell = (float) ((1u << n_bits) - 1);
+      std::vector<float> min_x(coords, coords + n_dims);
+      std::vector<float> max_x(coords, coords + n_dims);
+      for (std::size_t i=1; i < n_rows; ++i) {
+        for (std::size_t d=0; d < n_dims; ++d) {
+          min_x[d] = std::min(min_x[d], coords[i*n_cols+d]);
+          max_x[d] = std::max(max_x[d], coords[i*n_cols+d]);
+        }
+      }
+      std::vector<uint64_t> keys(n_rows);
+      std::size_t i, d, bit;
+      std::vector<uint32_t> x(n_dims);
+      #pragma omp parallel for default(none)\
+        private(i,d,bit)\
+        firstprivate(n_rows,n_cols,n_dims,n_bits,max_cell,x)\
+        shared(coords,curve,min_x,max_x,keys)
+      for (i=0; i < n_rows; ++i) {
+        // discretize coordinates to curve cells
+        for (d=0; d < n_dims; ++d) {
+          float width = max_x[d] - min_x[d];
+          if (width > 0.0f) {
+            x[d] = (uint32_t) std::min(max_cell
+                                     , (coords[i*n_cols+d] - min_x[d]) / width * max_cell);
+          } else {
+            x[d] = 0;
+          }
+        }
+        if (curve == "hilbert") {
+          hilbert_transpose(x, n_bits);
+        }
+        // interleave bits, most significant first
+        uint64_t key = 0;
+        for (bit=n_bits; bit > 0; --bit) {
+          for (d=0; d < n_dims; ++d) {
+            key = (key << 1) | ((x[d] >> (bit-1)) & 1u);
+          }
+        }
+        keys[i] = key;
+      }
+      std::stable_sort(order.begin()
+                     , order.end()
+                     , [&](std::size_t i, std::size_t j) -> bool {
+                         return keys[i] < keys[j];
+                       });
+      return order;
+    }
+
+    std::size_t
+    tie_id(const std::vector<std::size_t>& original_ids,
+           const std::size_t i) {
+      return (original_ids.empty() ? i : original_ids[i]);
     }
 
     std::vector<std::size_t>
@@ -126,11 +498,12 @@ namespace Clustering {
     calculate_populations(const float* coords,
                           const std::size_t n_rows,
                           const std::size_t n_cols,
-                          std::vector<float> radii) {
-      std::map<float, std::vector<std::size_t>> pops;
-      for (float rad: radii) {
-        pops[rad].resize(n_rows, 1);
-      }
+                          std::vector<float> radii,
+                          const std::size_t n_box_dims,
+                          const bool prefilter,
+                          const std::size_t n_pivots,
+                          const bool partial_distances,
+                          const Tiles::Parameters& tiles) {
       std::sort(radii.begin(), radii.end(), std::greater<float>());
       std::size_t n_radii = radii.size();
       std::vector<float> rad2(n_radii);
@@ -138,47 +511,121 @@ namespace Clustering {
         rad2[i] = radii[i]*radii[i];
       }
       ASSUME_ALIGNED(coords);
-      std::size_t i, j, k, l, ib;
-      BoxGrid grid = compute_box_grid(coords, n_rows, n_cols, radii[0]);
-      Clustering::logger(std::cout) << " box grid: "
-                                    << grid.n_boxes[0]
-                                    << " x "
-                                    << grid.n_boxes[1]
-                                    << std::endl;
+      // boxes are slightly wider than the radius, such that
+      // rounding of box coordinates does not lose neighbors.
+      BoxGrid grid = compute_box_grid(coords, n_rows, n_cols, radii[0] * 1.001f, n_box_dims);
+      log_box_grid(grid);
+      // frames of the same box are adjacent in memory, so that
+      // the neighbor scans are linear reads
+      const std::vector<float> sorted_coords = box_sorted_coords(coords, n_cols, grid);
+      const std::size_t n_nonempty_boxes = grid.box_ids.size();
       Clustering::logger(std::cout) << "computing pops" << std::endl;
-      float dist, c;
-      Box box;
-      Box center;
-      int i_neighbor;
-      std::vector<int> box_buffer;
-      #pragma omp parallel for default(none)\
-        private(i,box,box_buffer,center,i_neighbor,ib,dist,j,k,l,c)\
-        firstprivate(n_rows,n_cols,n_radii,radii,rad2,N_NEIGHBOR_BOXES)\
-        shared(coords,pops,grid)\
-        schedule(dynamic,1024)
-      for (i=0; i < n_rows; ++i) {
-        center = grid.assigned_box[i];
-        // loop over surrounding boxes to find neighbor candidates
-        for (i_neighbor=0; i_neighbor < N_NEIGHBOR_BOXES; ++i_neighbor) {
-          box = neighbor_box(center, i_neighbor);
-          if (is_valid_box(box, grid)) {
-            box_buffer = grid.boxes[box];
-            // loop over frames inside surrounding box
-            for (ib=0; ib < box_buffer.size(); ++ib) {
-              j = box_buffer[ib];
-              if (i < j) {
-                dist = 0.0f;
-                #pragma simd reduction(+:dist)
-                for (k=0; k < n_cols; ++k) {
-                  c = coords[i*n_cols+k] - coords[j*n_cols+k];
-                  dist += c*c;
-                }
+      // pops per radius index and box-sorted frame position.
+      // every frame's neighbors are counted by the thread owning
+      // the frame's box, which is the only one writing to it.
+      // thus, no atomic updates are needed (at the cost of comparing
+      // every pair twice).
+      std::vector<std::vector<std::size_t>> sorted_pops(n_radii
+                                                      , std::vector<std::size_t>(n_rows));
+      Prefilter::CompressedCoords cc;
+      if (prefilter) {
+        cc = Prefilter::compress_coords(sorted_coords.data(), n_rows, n_cols);
+      }
+      Pivots::PivotTable pt;
+      if (n_pivots > 0) {
+        pt = Pivots::compute_pivot_table(sorted_coords.data(), n_rows, n_cols, n_pivots);
+      }
+      PartialDistances::OrderedCoords oc;
+      if (partial_distances) {
+        oc = PartialDistances::variance_ordered_coords(sorted_coords.data(), n_rows, n_cols);
+      }
+      const PairFilter filter = pair_filter((prefilter ? &cc : nullptr)
+                                          , (n_pivots > 0 ? &pt : nullptr)
+                                          , (partial_distances ? &oc : nullptr)
+                                          , rad2[n_radii-1]
+                                          , rad2[0]);
+      // tiles of consecutive boxes with at least 'tile_size' frames,
+      // a single tile without checkpoints.
+      std::vector<std::size_t> tile_boxes = {0};
+      if ( ! tiles.filename.empty()) {
+        for (std::size_t b=0; b+1 < n_nonempty_boxes; ++b) {
+          if (grid.box_offsets[b+1] - grid.box_offsets[tile_boxes.back()] >= tiles.tile_size) {
+            tile_boxes.push_back(b+1);
+          }
+        }
+      }
+      tile_boxes.push_back(n_nonempty_boxes);
+      const std::size_t n_tiles = tile_boxes.size() - 1;
+      std::vector<std::size_t> n_tile_values(n_tiles);
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        n_tile_values[i_tile] = n_radii * (grid.box_offsets[tile_boxes[i_tile+1]] - grid.box_offsets[tile_boxes[i_tile]]);
+      }
+      uint64_t input_fingerprint = 0;
+      if ( ! tiles.filename.empty()) {
+        const uint64_t tile_params[2] = {n_box_dims, tiles.tile_size};
+        input_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float));
+        input_fingerprint = Tiles::fingerprint(radii.data(), n_radii*sizeof(float), input_fingerprint);
+        input_fingerprint = Tiles::fingerprint(tile_params, sizeof(tile_params), input_fingerprint);
+      }
+      Tiles::Checkpoint checkpoint = Tiles::open_checkpoint(tiles, "population", n_tile_values, input_fingerprint);
+      std::size_t i_box, i_neighbor, p, q, q_from, n_box_frames, n_computed, n_inside, l;
+      std::size_t n_candidates = 0;
+      std::size_t n_exact = 0;
+      std::size_t n_partial = 0;
+      std::size_t n_partial_cols = 0;
+      float dist;
+      std::vector<std::size_t> neighbors;
+      std::vector<std::size_t> counts;
+      CandidateBuffers buf;
+      std::vector<uint64_t> tile_values;
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        const std::size_t box_from = tile_boxes[i_tile];
+        const std::size_t box_to = tile_boxes[i_tile+1];
+        const std::size_t p_from = grid.box_offsets[box_from];
+        const std::size_t n_tile_frames = grid.box_offsets[box_to] - p_from;
+        if (checkpoint.done[i_tile]) {
+          // format: [l * n_tile_frames + (p - p_from)]
+          const std::vector<uint64_t>& values = checkpoint.values[i_tile];
+          for (l=0; l < n_radii; ++l) {
+            for (p=0; p < n_tile_frames; ++p) {
+              sorted_pops[l][p_from+p] = values[l*n_tile_frames + p];
+            }
+          }
+          continue;
+        }
+        #pragma omp parallel for default(none)\
+          private(i_box,i_neighbor,p,q,q_from,n_box_frames,n_computed,n_inside,l,dist)\
+          firstprivate(n_cols,n_radii,box_from,box_to,rad2,filter,neighbors,counts,buf)\
+          shared(sorted_coords,sorted_pops,grid)\
+          reduction(+:n_candidates,n_exact,n_partial,n_partial_cols)\
+          schedule(dynamic,16)
+        for (i_box=box_from; i_box < box_to; ++i_box) {
+          neighbor_boxes(grid, i_box, neighbors);
+          for (p=grid.box_offsets[i_box]; p < grid.box_offsets[i_box+1]; ++p) {
+            // every frame counts itself
+            counts.assign(n_radii, 1);
+            n_inside = 0;
+            // loop over frames inside surrounding boxes
+            for (i_neighbor=0; i_neighbor < neighbors.size(); ++i_neighbor) {
+              q_from = grid.box_offsets[neighbors[i_neighbor]];
+              n_box_frames = grid.box_offsets[neighbors[i_neighbor]+1] - q_from;
+              n_computed = candidate_distances(sorted_coords.data()
+                                             , filter
+                                             , n_cols
+                                             , p
+                                             , q_from
+                                             , n_box_frames
+                                             , buf
+                                             , n_inside
+                                             , n_partial
+                                             , n_partial_cols);
+              n_candidates += n_box_frames;
+              n_exact += n_computed;
+              for (q=0; q < n_computed; ++q) {
+                dist = buf.dist2[q];
                 for (l=0; l < n_radii; ++l) {
                   if (dist < rad2[l]) {
-                    #pragma omp atomic
-                    pops[radii[l]][i] += 1;
-                    #pragma omp atomic
-                    pops[radii[l]][j] += 1;
+                    ++counts[l];
                   } else {
                     // if it's not in the bigger radius,
                     // it won't be in the smaller ones.
@@ -187,11 +634,240 @@ namespace Clustering {
                 }
               }
             }
+            for (l=0; l < n_radii; ++l) {
+              sorted_pops[l][p] = counts[l] + n_inside;
+            }
+          }
+        }
+        if (checkpoint.enabled) {
+          tile_values.resize(n_radii*n_tile_frames);
+          for (l=0; l < n_radii; ++l) {
+            for (p=0; p < n_tile_frames; ++p) {
+              tile_values[l*n_tile_frames + p] = sorted_pops[l][p_from+p];
+            }
+          }
+          Tiles::save_tile(checkpoint, i_tile, tile_values);
+        }
+      }
+      if (prefilter || n_pivots > 0 || partial_distances) {
+        log_filter_stats(n_candidates, n_exact);
+      }
+      if (partial_distances) {
+        log_partial_stats(n_partial, n_partial_cols, n_cols);
+      }
+      // restore original frame order
+      std::map<float, std::vector<std::size_t>> pops;
+      for (l=0; l < n_radii; ++l) {
+        std::vector<std::size_t>& rad_pops = pops[radii[l]];
+        rad_pops.resize(n_rows);
+        for (p=0; p < n_rows; ++p) {
+          rad_pops[grid.frames[p]] = sorted_pops[l][p];
+        }
+      }
+      return pops;
+    }
+
+    std::map<float, std::vector<std::size_t>>
+    calculate_population_profiles(const float* coords,
+                                  const std::size_t n_rows,
+                                  const std::size_t n_cols,
+                                  std::vector<float> radii,
+                                  const std::size_t n_box_dims,
+                                  const bool prefilter,
+                                  const std::size_t n_pivots,
+                                  const bool partial_distances) {
+      // ascending radii: the histogram bucket of a pair is the
+      // index of the smallest radius enclosing it.
+      std::sort(radii.begin(), radii.end());
+      std::size_t n_radii = radii.size();
+      std::vector<float> rad2(n_radii);
+      for (std::size_t i=0; i < n_radii; ++i) {
+        rad2[i] = radii[i]*radii[i];
+      }
+      const float rad2_max = rad2[n_radii-1];
+      // lookup table to guess the histogram bucket of a squared distance
+      // (the first radius enclosing it) in constant time. the guess is
+      // corrected by comparison against the squared radii, such that the
+      // bucket is exact even for rounding errors of the table index.
+      const std::size_t n_cells = 16*n_radii;
+      const float cell_scale = n_cells / rad2_max;
+      std::vector<std::size_t> bucket_guess(n_cells+1);
+      for (std::size_t c=0; c <= n_cells; ++c) {
+        bucket_guess[c] = std::upper_bound(rad2.begin()
+                                         , rad2.end()
+                                         , c / cell_scale) - rad2.begin();
+      }
+      ASSUME_ALIGNED(coords);
+      // boxes are slightly wider than the radius, such that
+      // rounding of box coordinates does not lose neighbors.
+      BoxGrid grid = compute_box_grid(coords, n_rows, n_cols, radii[n_radii-1] * 1.001f, n_box_dims);
+      log_box_grid(grid);
+      const std::vector<float> sorted_coords = box_sorted_coords(coords, n_cols, grid);
+      const std::size_t n_nonempty_boxes = grid.box_ids.size();
+      Clustering::logger(std::cout) << "computing population profiles for "
+                                    << n_radii << " radii" << std::endl;
+      // cumulative neighbor counts per box-sorted frame position and radius,
+      // format: [p * n_radii + l]. every profile is written only by the
+      // thread owning the frame's box.
+      std::vector<std::size_t> profiles(n_rows*n_radii);
+      Prefilter::CompressedCoords cc;
+      if (prefilter) {
+        cc = Prefilter::compress_coords(sorted_coords.data(), n_rows, n_cols);
+      }
+      Pivots::PivotTable pt;
+      if (n_pivots > 0) {
+        pt = Pivots::compute_pivot_table(sorted_coords.data(), n_rows, n_cols, n_pivots);
+      }
+      PartialDistances::OrderedCoords oc;
+      if (partial_distances) {
+        oc = PartialDistances::variance_ordered_coords(sorted_coords.data(), n_rows, n_cols);
+      }
+      const PairFilter filter = pair_filter((prefilter ? &cc : nullptr)
+                                          , (n_pivots > 0 ? &pt : nullptr)
+                                          , (partial_distances ? &oc : nullptr)
+                                          , rad2[0]
+                                          , rad2_max);
+      std::size_t i_box, i_neighbor, p, q, q_from, n_box_frames, n_computed, n_inside, l, b;
+      std::size_t n_candidates = 0;
+      std::size_t n_exact = 0;
+      std::size_t n_partial = 0;
+      std::size_t n_partial_cols = 0;
+      float d2;
+      std::vector<std::size_t> neighbors;
+      // neighbor histogram over radius intervals, the last bucket
+      // collects all pairs outside of the largest radius.
+      std::vector<std::size_t> hist;
+      CandidateBuffers buf;
+      #pragma omp parallel for default(none)\
+        private(i_box,i_neighbor,p,q,q_from,n_box_frames,n_computed,n_inside,l,b,d2)\
+        firstprivate(n_cols,n_radii,n_nonempty_boxes,n_cells,cell_scale,rad2_max,filter,neighbors,hist,buf)\
+        shared(sorted_coords,profiles,grid,rad2,bucket_guess)\
+        reduction(+:n_candidates,n_exact,n_partial,n_partial_cols)\
+        schedule(dynamic,16)
+      for (i_box=0; i_box < n_nonempty_boxes; ++i_box) {
+        neighbor_boxes(grid, i_box, neighbors);
+        for (p=grid.box_offsets[i_box]; p < grid.box_offsets[i_box+1]; ++p) {
+          hist.assign(n_radii+1, 0);
+          n_inside = 0;
+          for (i_neighbor=0; i_neighbor < neighbors.size(); ++i_neighbor) {
+            q_from = grid.box_offsets[neighbors[i_neighbor]];
+            n_box_frames = grid.box_offsets[neighbors[i_neighbor]+1] - q_from;
+            n_computed = candidate_distances(sorted_coords.data()
+                                           , filter
+                                           , n_cols
+                                           , p
+                                           , q_from
+                                           , n_box_frames
+                                           , buf
+                                           , n_inside
+                                           , n_partial
+                                           , n_partial_cols);
+            n_candidates += n_box_frames;
+            n_exact += n_computed;
+            for (q=0; q < n_computed; ++q) {
+              d2 = buf.dist2[q];
+              // most candidates are outside of the largest radius
+              if (d2 < rad2_max) {
+                // first radius with d2 < rad2
+                b = bucket_guess[std::min(n_cells, (std::size_t) (d2 * cell_scale))];
+                while (b > 0 && d2 < rad2[b-1]) {
+                  --b;
+                }
+                while (b < n_radii && ! (d2 < rad2[b])) {
+                  ++b;
+                }
+                ++hist[b];
+              }
+            }
+          }
+          // pairs inside of the smallest radius
+          hist[0] += n_inside;
+          // cumulative counts; every frame counts itself
+          std::size_t count = 1;
+          for (l=0; l < n_radii; ++l) {
+            count += hist[l];
+            profiles[p*n_radii+l] = count;
           }
         }
       }
+      if (prefilter || n_pivots > 0 || partial_distances) {
+        log_filter_stats(n_candidates, n_exact);
+      }
+      if (partial_distances) {
+        log_partial_stats(n_partial, n_partial_cols, n_cols);
+      }
+      // emit populations per radius in original frame order
+      std::map<float, std::vector<std::size_t>> pops;
+      for (l=0; l < n_radii; ++l) {
+        std::vector<std::size_t>& rad_pops = pops[radii[l]];
+        rad_pops.resize(n_rows);
+        for (p=0; p < n_rows; ++p) {
+          rad_pops[grid.frames[p]] = profiles[p*n_radii+l];
+        }
+      }
       return pops;
     }
+
+    std::map<float, std::vector<std::size_t>>
+    calculate_populations(const float* coords,
+                          const std::size_t n_rows,
+                          const std::size_t n_cols,
+                          const std::vector<float> radii,
+                          const std::string engine,
+                          const std::size_t n_box_dims,
+                          const bool prefilter,
+                          const std::size_t n_pivots,
+                          const bool partial_distances,
+                          const LSH::Parameters& lsh_params,
+                          const Tiles::Parameters& tiles) {
+      if (engine != "boxes" && engine != "kdtree" && engine != "profile" && engine != "lsh" && engine != "gemm") {
+        std::cerr << "error: unknown population engine '" << engine << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+#ifdef USE_CUDA
+      return Clustering::Density::CUDA::calculate_populations(coords
+                                                            , n_rows
+                                                            , n_cols
+                                                            , radii);
+#else
+      if (engine == "kdtree") {
+        return Clustering::Density::KDTree::calculate_populations(coords
+                                                                , n_rows
+                                                                , n_cols
+                                                                , radii);
+      } else if (engine == "gemm") {
+        return GEMM::calculate_populations(coords
+                                         , n_rows
+                                         , n_cols
+                                         , radii);
+      } else if (engine == "lsh") {
+        return LSH::calculate_populations(coords
+                                        , n_rows
+                                        , n_cols
+                                        , radii
+                                        , lsh_params);
+      } else if (engine == "profile") {
+        return calculate_population_profiles(coords
+                                           , n_rows
+                                           , n_cols
+                                           , radii
+                                           , n_box_dims
+                                           , prefilter
+                                           , n_pivots
+                                           , partial_distances);
+      } else {
+        return calculate_populations(coords
+                                   , n_rows
+                                   , n_cols
+                                   , radii
+                                   , n_box_dims
+                                   , prefilter
+                                   , n_pivots
+                                   , partial_distances
+                                   , tiles);
+      }
+#endif
+    }
   
     std::vector<float>
     calculate_free_energies(const std::vector<std::size_t>& pops) {
@@ -211,10 +887,13 @@ namespace Clustering {
     }
   
     std::vector<FreeEnergy>
-    sorted_free_energies(const std::vector<float>& fe) {
-      std::vector<FreeEnergy> fe_sorted;
+    sorted_free_energies(const std::vector<float>& fe,
+                         const std::vector<std::size_t>& original_ids) {
+      // frames in original order: the sort only compares free energies,
+      // i.e. the order of equal free energies is the same as without reordering.
+      std::vector<FreeEnergy> fe_sorted(fe.size());
       for (std::size_t i=0; i < fe.size(); ++i) {
-        fe_sorted.push_back(FreeEnergy(i, fe[i]));
+        fe_sorted[tie_id(original_ids, i)] = FreeEnergy(i, fe[i]);
       }
       // sort for free energy: lowest to highest
       // (low free energy = high density)
@@ -230,113 +909,549 @@ namespace Clustering {
     nearest_neighbors(const float* coords,
                       const std::size_t n_rows,
                       const std::size_t n_cols,
-                      const std::vector<float>& free_energy) {
+                      const std::vector<float>& free_energy,
+                      const bool prefilter,
+                      const std::size_t n_pivots,
+                      const bool partial_distances,
+                      const Tiles::Parameters& tiles,
+                      const std::vector<std::size_t>& original_ids) {
 //TODO: there is a small error somewhere that misclassifies frames as
 //      nearest neighbors. compare to results with CUDA-driven code
 //      (whose output was manually checked for correctness)
-      Neighborhood nh;
-      Neighborhood nh_high_dens;
       // initialize neighborhood
-      for (std::size_t i=0; i < n_rows; ++i) {
-        nh[i] = Neighbor(n_rows+1
-                       , std::numeric_limits<float>::max());
-        nh_high_dens[i] = Neighbor(n_rows+1
-                                 , std::numeric_limits<float>::max());
-      }
-      // calculate nearest neighbors with distances
-      std::size_t i, j, c, min_j, min_j_high_dens;
-      float dist, d, mindist, mindist_high_dens;
+      Neighborhood nh(n_rows, n_rows+1, std::numeric_limits<float>::max());
+      Neighborhood nh_high_dens(n_rows, n_rows+1, std::numeric_limits<float>::max());
+      Prefilter::CompressedCoords cc;
+      if (prefilter) {
+        cc = Prefilter::compress_coords(coords, n_rows, n_cols);
+      }
+      Pivots::PivotTable pt;
+      if (n_pivots > 0) {
+        pt = Pivots::compute_pivot_table(coords, n_rows, n_cols, n_pivots);
+      }
+      PartialDistances::OrderedCoords oc;
+      if (partial_distances) {
+        oc = PartialDistances::variance_ordered_coords(coords, n_rows, n_cols);
+      }
+      const bool use_filter = (prefilter || n_pivots > 0 || partial_distances);
+      // calculate nearest neighbors with distances,
+      // distances are computed in chunks of frames
+      const std::size_t chunk_size = 1024;
+      std::size_t i, j, j_from, n_chunk, n_exact, min_j, min_j_high_dens;
+      std::size_t n_candidates = 0;
+      std::size_t n_computed = 0;
+      std::size_t n_partial = 0;
+      std::size_t n_partial_cols = 0;
+      float dist, mindist, mindist_high_dens;
+      PairFilter filter, filter_high_dens;
+      std::vector<std::size_t> chunk_frames(chunk_size);
+      std::vector<float> dist2(chunk_size);
+      // bounds of inactive filters stay zero and do not skip any frame
+      std::vector<float> approx_dist2(chunk_size, 0.0f);
+      std::vector<float> lower(chunk_size, 0.0f);
+      std::vector<float> upper(chunk_size);
+      std::vector<float> partial_dist2(chunk_size);
+      std::vector<float> partial_reject_thr(chunk_size);
       ASSUME_ALIGNED(coords);
-      #pragma omp parallel for default(none) \
-        private(i,j,c,dist,d,mindist,mindist_high_dens,min_j,min_j_high_dens)\
-        firstprivate(n_rows,n_cols) \
-        shared(coords,nh,nh_high_dens,free_energy) \
-        schedule(dynamic, 2048)
-      for (i=0; i < n_rows; ++i) {
-        mindist = std::numeric_limits<float>::max();
-        mindist_high_dens = std::numeric_limits<float>::max();
-        min_j = n_rows+1;
-        min_j_high_dens = n_rows+1;
-        for (j=0; j < n_rows; ++j) {
-          if (i != j) {
-            dist = 0.0f;
-            #pragma simd reduction(+:dist)
-            for (c=0; c < n_cols; ++c) {
-              d = coords[i*n_cols+c] - coords[j*n_cols+c];
-              dist += d*d;
-            }
-            // direct neighbor
-            if (dist < mindist) {
-              mindist = dist;
-              min_j = j;
+      // tiles of 'tile_size' frames, a single tile without checkpoints
+      const std::size_t tile_size = (tiles.filename.empty() ? std::max(n_rows, (std::size_t) 1) : tiles.tile_size);
+      const std::size_t n_tiles = (n_rows + tile_size - 1) / tile_size;
+      // 4 values per frame, see below
+      std::vector<std::size_t> n_tile_values(n_tiles);
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        n_tile_values[i_tile] = 4 * (std::min(n_rows, (i_tile+1)*tile_size) - i_tile*tile_size);
+      }
+      uint64_t input_fingerprint = 0;
+      if ( ! tiles.filename.empty()) {
+        const uint64_t tile_params[1] = {tile_size};
+        input_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float));
+        input_fingerprint = Tiles::fingerprint(free_energy.data(), n_rows*sizeof(float), input_fingerprint);
+        input_fingerprint = Tiles::fingerprint(tile_params, sizeof(tile_params), input_fingerprint);
+        input_fingerprint = Tiles::fingerprint(original_ids.data(), original_ids.size()*sizeof(std::size_t), input_fingerprint);
+      }
+      // with tie ids, frames at exactly the current neighbor distance
+      // may still replace the neighbor and must not be rejected by filters.
+      // (this matters for zero distances, where the filters have no tolerance.)
+      const bool widen_filters = ( ! original_ids.empty());
+      const float inf = std::numeric_limits<float>::infinity();
+      Tiles::Checkpoint checkpoint = Tiles::open_checkpoint(tiles, "nearest neighbor", n_tile_values, input_fingerprint);
+      std::vector<uint64_t> tile_values;
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        const std::size_t i_from = i_tile*tile_size;
+        const std::size_t i_to = std::min(n_rows, i_from+tile_size);
+        if (checkpoint.done[i_tile]) {
+          // format: [(i - i_from) * 4 + {id, dist2, id high dens, dist2 high dens}]
+          const std::vector<uint64_t>& values = checkpoint.values[i_tile];
+          for (i=i_from; i < i_to; ++i) {
+            nh.set(i, values[4*(i-i_from)], Tiles::value_float(values[4*(i-i_from)+1]));
+            nh_high_dens.set(i, values[4*(i-i_from)+2], Tiles::value_float(values[4*(i-i_from)+3]));
+          }
+          continue;
+        }
+        #pragma omp parallel for default(none) \
+          private(i,j,j_from,n_chunk,n_exact,dist,mindist,mindist_high_dens,min_j,min_j_high_dens,filter,filter_high_dens)\
+          firstprivate(n_rows,n_cols,i_from,i_to,chunk_size,prefilter,n_pivots,partial_distances,use_filter,widen_filters,inf,chunk_frames,dist2,approx_dist2,lower,upper,partial_dist2,partial_reject_thr) \
+          shared(coords,cc,pt,oc,nh,nh_high_dens,free_energy,original_ids) \
+          reduction(+:n_candidates,n_computed,n_partial,n_partial_cols) \
+          schedule(dynamic, 2048)
+        for (i=i_from; i < i_to; ++i) {
+          mindist = std::numeric_limits<float>::max();
+          mindist_high_dens = std::numeric_limits<float>::max();
+          min_j = n_rows+1;
+          min_j_high_dens = n_rows+1;
+          for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+            n_chunk = std::min(chunk_size, n_rows-j_from);
+            if (use_filter) {
+              // skip frames that cannot be closer than the current
+              // neighbors (the minima only decrease inside the chunk).
+              filter = pair_filter((prefilter ? &cc : nullptr)
+                                 , (n_pivots > 0 ? &pt : nullptr)
+                                 , (partial_distances ? &oc : nullptr)
+                                 , 0.0f
+                                 , widen_filters ? std::nextafter(mindist, inf) : mindist);
+              filter_high_dens = pair_filter((prefilter ? &cc : nullptr)
+                                           , (n_pivots > 0 ? &pt : nullptr)
+                                           , (partial_distances ? &oc : nullptr)
+                                           , 0.0f
+                                           , widen_filters ? std::nextafter(mindist_high_dens, inf) : mindist_high_dens);
+              if (prefilter) {
+                Prefilter::approx_squared_distances(cc, i, j_from, n_chunk, approx_dist2.data());
+              }
+              if (n_pivots > 0) {
+                Pivots::distance_bounds(pt, i, j_from, n_chunk, lower.data(), upper.data());
+              }
+              n_exact = 0;
+              for (j=j_from; j < j_from+n_chunk; ++j) {
+                if ((approx_dist2[j-j_from] < filter.reject_thr
+                  && lower[j-j_from] < filter.pivot_reject_thr)
+                 || (free_energy[j] < free_energy[i]
+                  && approx_dist2[j-j_from] < filter_high_dens.reject_thr
+                  && lower[j-j_from] < filter_high_dens.pivot_reject_thr)) {
+                  chunk_frames[n_exact] = j;
+                  ++n_exact;
+                }
+              }
+              if (partial_distances) {
+                // frames with lower free energy may still become
+                // neighbors with higher density at larger distances
+                for (std::size_t q=0; q < n_exact; ++q) {
+                  partial_reject_thr[q] = (free_energy[chunk_frames[q]] < free_energy[i])
+                                        ? std::max(filter.partial_reject_thr, filter_high_dens.partial_reject_thr)
+                                        : filter.partial_reject_thr;
+                }
+                n_partial += n_exact;
+                n_partial_cols += PartialDistances::partial_squared_distances(oc
+                                                                            , i
+                                                                            , chunk_frames.data()
+                                                                            , n_exact
+                                                                            , partial_reject_thr.data()
+                                                                            , partial_dist2.data());
+                std::size_t n_remaining = 0;
+                for (std::size_t q=0; q < n_exact; ++q) {
+                  if (partial_dist2[q] < partial_reject_thr[q]) {
+                    chunk_frames[n_remaining] = chunk_frames[q];
+                    ++n_remaining;
+                  }
+                }
+                n_exact = n_remaining;
+              }
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , coords
+                                    , chunk_frames.data()
+                                    , n_exact
+                                    , n_cols
+                                    , dist2.data());
+            } else {
+              n_exact = n_chunk;
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , &coords[j_from*n_cols]
+                                    , n_chunk
+                                    , n_cols
+                                    , dist2.data());
             }
-            // next neighbor with higher density / lower free energy
-            if (free_energy[j] < free_energy[i]
-             && dist < mindist_high_dens) {
-              mindist_high_dens = dist;
-              min_j_high_dens = j;
+            n_candidates += n_chunk;
+            n_computed += n_exact;
+            // frames in ascending order, as in exhaustive search
+            for (std::size_t q=0; q < n_exact; ++q) {
+              j = (use_filter ? chunk_frames[q] : j_from+q);
+              if (i == j) {
+                continue;
+              }
+              dist = dist2[q];
+              // direct neighbor
+              if (dist < mindist
+               || (dist == mindist
+                && min_j < n_rows
+                && tie_id(original_ids, j) < tie_id(original_ids, min_j))) {
+                mindist = dist;
+                min_j = j;
+              }
+              // next neighbor with higher density / lower free energy
+              if (free_energy[j] < free_energy[i]
+               && (dist < mindist_high_dens
+                || (dist == mindist_high_dens
+                 && min_j_high_dens < n_rows
+                 && tie_id(original_ids, j) < tie_id(original_ids, min_j_high_dens)))) {
+                mindist_high_dens = dist;
+                min_j_high_dens = j;
+              }
             }
           }
+          nh.set(i, min_j, mindist);
+          nh_high_dens.set(i, min_j_high_dens, mindist_high_dens);
+        }
+        if (checkpoint.enabled) {
+          tile_values.resize(4*(i_to-i_from));
+          for (i=i_from; i < i_to; ++i) {
+            tile_values[4*(i-i_from)] = nh.ids[i];
+            tile_values[4*(i-i_from)+1] = Tiles::float_value(nh.dist2[i]);
+            tile_values[4*(i-i_from)+2] = nh_high_dens.ids[i];
+            tile_values[4*(i-i_from)+3] = Tiles::float_value(nh_high_dens.dist2[i]);
+          }
+          Tiles::save_tile(checkpoint, i_tile, tile_values);
         }
-        nh[i] = Neighbor(min_j
-                       , mindist);
-        nh_high_dens[i] = Neighbor(min_j_high_dens
-                                 , mindist_high_dens);
+      }
+      if (use_filter) {
+        log_filter_stats(n_candidates, n_computed);
+      }
+      if (partial_distances) {
+        log_partial_stats(n_partial, n_partial_cols, n_cols);
       }
       return std::make_tuple(nh, nh_high_dens);
     }
   
     // returns neighborhood set of single frame.
     // all ids are sorted in free energy.
-    std::set<std::size_t>
-    high_density_neighborhood(const float* coords,
+    ScreeningIndex
+    screening_index(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<FreeEnergy>& sorted_fe,
+                    const float max_dist,
+                    const NeighborGraph::Graph* graph) {
+      ScreeningIndex index;
+      index.max_dist = max_dist;
+      index.n_admitted = 0;
+      index.graph = nullptr;
+      if (graph) {
+        if (max_dist <= graph->cutoff * graph->cutoff) {
+          // all neighbors are in the graph, no grid needed
+          index.graph = graph;
+          index.sorted_position.resize(n_rows);
+          for (std::size_t j=0; j < n_rows; ++j) {
+            index.sorted_position[sorted_fe[j].first] = j;
+          }
+          return index;
+        }
+        Clustering::logger(std::cout) << "    distance criterion exceeds cutoff of neighbor graph,"
+                                      << " using box grid" << std::endl;
+      }
+      if (max_dist > 0.0f) {
+        // frames closer than the query radius differ by at most one box
+        // per dimension. boxes are slightly wider than the radius,
+        // such that rounding of box coordinates does not lose neighbors.
+        index.grid = compute_box_grid(coords
+                                    , n_rows
+                                    , n_cols
+                                    , std::sqrt(max_dist) * 1.001f
+                                    , DEFAULT_BOX_DIMS);
+      } else {
+        // no neighbors but the frame itself: single box
+        index.grid = compute_box_grid(coords, n_rows, n_cols, 1.0f, 0);
+      }
+      // group frames by box in order of free energy
+      const BoxGrid& grid = index.grid;
+      index.box_frames.resize(n_rows);
+      index.n_box_admitted.assign(grid.box_ids.size(), 0);
+      for (std::size_t j=0; j < n_rows; ++j) {
+        std::size_t i_box = grid.assigned_box[sorted_fe[j].first];
+        index.box_frames[grid.box_offsets[i_box] + index.n_box_admitted[i_box]] = j;
+        ++index.n_box_admitted[i_box];
+      }
+      std::fill(index.n_box_admitted.begin(), index.n_box_admitted.end(), 0);
+      return index;
+    }
+
+    void
+    admit_frames(ScreeningIndex& index,
+                 const std::vector<FreeEnergy>& sorted_fe,
+                 const std::size_t limit) {
+      if (index.graph) {
+        index.n_admitted = std::max(index.n_admitted, limit);
+        return;
+      }
+      for (std::size_t j=index.n_admitted; j < limit; ++j) {
+        ++index.n_box_admitted[index.grid.assigned_box[sorted_fe[j].first]];
+      }
+      index.n_admitted = std::max(index.n_admitted, limit);
+    }
+
+    const std::vector<std::size_t>&
+    high_density_neighborhood(const ScreeningIndex& index,
+                              ScreeningQuery& query,
+                              const float* coords,
                               const std::size_t n_cols,
                               const std::vector<FreeEnergy>& sorted_fe,
-                              const std::size_t i_frame,
-                              const std::size_t limit,
-                              const float max_dist) {
-      // buffer to hold information whether frame i is
-      // in neighborhood (-> assign 1) or not (-> keep 0)
-      std::vector<int> frame_in_nh(limit, 0);
-      std::set<std::size_t> nh;
-      std::size_t j,c;
-      const std::size_t i_frame_sorted = sorted_fe[i_frame].first * n_cols;
-      float d,dist2;
+                              const std::size_t i_frame) {
+      if (index.graph) {
+        // admitted graph neighbors within the distance criterion
+        const NeighborGraph::Graph& graph = *index.graph;
+        const std::size_t i = sorted_fe[i_frame].first;
+        query.neighbors.assign(1, i_frame);
+        for (std::size_t k=graph.offsets[i]; k < graph.offsets[i+1]; ++k) {
+          std::size_t j = index.sorted_position[graph.ids[k]];
+          if (j < index.n_admitted && graph.dist2[k] < index.max_dist) {
+            query.neighbors.push_back(j);
+          }
+        }
+        std::sort(query.neighbors.begin(), query.neighbors.end());
+        return query.neighbors;
+      }
+      // collect admitted frames of neighboring boxes
+      neighbor_boxes(index.grid
+                   , index.grid.assigned_box[sorted_fe[i_frame].first]
+                   , query.neighbor_boxes);
+      query.candidates.clear();
+      for (std::size_t i_box: query.neighbor_boxes) {
+        auto box_begin = index.box_frames.begin() + index.grid.box_offsets[i_box];
+        query.candidates.insert(query.candidates.end()
+                              , box_begin
+                              , box_begin + index.n_box_admitted[i_box]);
+      }
+      const std::size_t n_candidates = query.candidates.size();
+      query.candidate_ids.resize(n_candidates);
+      query.dist2.resize(n_candidates);
+      for (std::size_t c=0; c < n_candidates; ++c) {
+        query.candidate_ids[c] = sorted_fe[query.candidates[c]].first;
+      }
+      // distances are computed in chunks of frames
+      const std::size_t chunk_size = 256;
+      std::size_t c_from, n_chunk;
+      const float* ref = &coords[sorted_fe[i_frame].first * n_cols];
+      const std::size_t* candidate_ids = query.candidate_ids.data();
+      float* dist2 = query.dist2.data();
       ASSUME_ALIGNED(coords);
       #pragma omp parallel for default(none)\
-        private(j,c,d,dist2)\
-        firstprivate(i_frame,i_frame_sorted,limit,max_dist,n_cols)\
-        shared(coords,sorted_fe,frame_in_nh)
-      for (j=0; j < limit; ++j) {
-        if (i_frame != j) {
-          dist2 = 0.0f;
-          #pragma simd reduction(+:dist2)
-          for (c=0; c < n_cols; ++c) {
-            d = coords[i_frame_sorted+c] - coords[sorted_fe[j].first*n_cols+c];
-            dist2 += d*d;
+        private(c_from,n_chunk)\
+        firstprivate(ref,n_candidates,n_cols,chunk_size,candidate_ids,dist2)\
+        shared(coords)
+      for (c_from=0; c_from < n_candidates; c_from += chunk_size) {
+        n_chunk = std::min(chunk_size, n_candidates-c_from);
+        SIMD::squared_distances(ref
+                              , coords
+                              , &candidate_ids[c_from]
+                              , n_chunk
+                              , n_cols
+                              , &dist2[c_from]);
+      }
+      query.neighbors.assign(1, i_frame);
+      for (std::size_t c=0; c < n_candidates; ++c) {
+        if (query.candidates[c] != i_frame && dist2[c] < index.max_dist) {
+          query.neighbors.push_back(query.candidates[c]);
+        }
+      }
+      std::sort(query.neighbors.begin(), query.neighbors.end());
+      return query.neighbors;
+    }
+
+    namespace {
+      //! root of frame's component (with path halving).
+      //! concurrent updates only move frames to ancestors.
+      std::size_t
+      find_component(std::vector<std::atomic<std::size_t>>& parent
+                   , std::size_t i) {
+        std::size_t p = parent[i].load();
+        while (p != i) {
+          std::size_t grand_parent = parent[p].load();
+          if (grand_parent != p) {
+            parent[i].compare_exchange_weak(p, grand_parent);
+          }
+          i = grand_parent;
+          p = parent[i].load();
+        }
+        return i;
+      }
+
+      //! lock-free union of components: the root of higher index
+      //! is linked to the root of lower index.
+      void
+      link_components(std::vector<std::atomic<std::size_t>>& parent
+                    , std::size_t i
+                    , std::size_t j) {
+        while (true) {
+          i = find_component(parent, i);
+          j = find_component(parent, j);
+          if (i == j) {
+            return;
+          }
+          if (i < j) {
+            std::swap(i, j);
+          }
+          std::size_t expected = i;
+          if (parent[i].compare_exchange_strong(expected, j)) {
+            return;
+          }
+          // 'i' got linked concurrently, retry from its new root
+        }
+      }
+    } // end local namespace
+
+    void
+    write_screening_checkpoint(const std::string filename
+                             , const ScreeningCheckpoint& checkpoint) {
+      // write to temporary file first, such that a job interrupted
+      // while writing does not destroy the previous checkpoint.
+      const std::string tmp_filename = filename + ".tmp";
+      {
+        std::ofstream ofs(tmp_filename);
+        if (ofs.fail()) {
+          std::cerr << "error: cannot open file '" << tmp_filename << "' for writing." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        // format: header line 'N_THRESHOLDS THRESHOLD N_FRAMES', followed by clusters
+        ofs << checkpoint.n_thresholds << " "
+            << std::setprecision(9) << checkpoint.threshold << " "
+            << checkpoint.clustering.size() << "\n";
+        for (std::size_t name: checkpoint.clustering) {
+          ofs << name << "\n";
+        }
+        ofs.close();
+        if (ofs.fail()) {
+          std::cerr << "error: cannot write screening checkpoint to '" << tmp_filename << "'." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+      }
+      if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "error: cannot replace screening checkpoint '" << filename << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    ScreeningCheckpoint
+    read_screening_checkpoint(const std::string filename) {
+      std::ifstream ifs(filename);
+      if (ifs.fail()) {
+        std::cerr << "error: cannot open file '" << filename << "'" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      ScreeningCheckpoint checkpoint;
+      std::size_t n_frames = 0;
+      ifs >> checkpoint.n_thresholds >> checkpoint.threshold >> n_frames;
+      checkpoint.clustering.resize(n_frames);
+      for (std::size_t i=0; i < n_frames; ++i) {
+        ifs >> checkpoint.clustering[i];
+      }
+      if (ifs.fail()) {
+        std::cerr << "error: screening checkpoint '" << filename << "' is truncated or corrupt." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      return checkpoint;
+    }
+
+    ScreeningComponents
+    screening_components(const std::vector<float>& free_energy
+                       , const Neighborhood& nh
+                       , const float* coords
+                       , const std::size_t n_rows
+                       , const std::size_t n_cols
+                       , const NeighborGraph::Graph* graph
+                       , const std::vector<std::size_t>& initial_clustering
+                       , const std::vector<std::size_t>& original_ids) {
+      ScreeningComponents components;
+      components.fe_sorted = sorted_free_energies(free_energy, original_ids);
+      components.sigma2 = compute_sigma2(nh);
+      components.index = screening_index(coords, n_rows, n_cols, components.fe_sorted, 4*components.sigma2, graph);
+      components.parent = std::vector<std::atomic<std::size_t>>(n_rows);
+      for (std::size_t i=0; i < n_rows; ++i) {
+        components.parent[i].store(i);
+      }
+      if ( ! initial_clustering.empty()) {
+        // continue from the clusters of a lower threshold:
+        // every cluster's frame of lowest free energy is its root.
+        std::vector<std::size_t> roots;
+        std::size_t n_clustered = 0;
+        for (std::size_t i=0; i < n_rows; ++i) {
+          std::size_t name = initial_clustering[components.fe_sorted[i].first];
+          if (name != 0) {
+            if (roots.size() <= name) {
+              roots.resize(name+1, n_rows);
+            }
+            if (roots[name] == n_rows) {
+              roots[name] = i;
+            }
+            components.parent[i].store(roots[name]);
+            ++n_clustered;
           }
-          if (dist2 < max_dist) {
-            frame_in_nh[j] = 1;
+        }
+        admit_frames(components.index, components.fe_sorted, n_clustered);
+      }
+      return components;
+    }
+
+    std::vector<std::size_t>
+    screening_components_step(ScreeningComponents& components
+                            , const float free_energy_threshold
+                            , const float* coords
+                            , const std::size_t n_cols) {
+      const std::vector<FreeEnergy>& fe_sorted = components.fe_sorted;
+      const std::size_t n_rows = fe_sorted.size();
+      auto lb = std::upper_bound(fe_sorted.begin()
+                               , fe_sorted.end()
+                               , FreeEnergy(0, free_energy_threshold)
+                               , [](const FreeEnergy& d1
+                                  , const FreeEnergy& d2) -> bool {
+                                   return d1.second < d2.second;
+                                 });
+      const std::size_t n_below = components.index.n_admitted;
+      const std::size_t first_frame_above_threshold = std::max(n_below
+                                                             , (std::size_t) (lb - fe_sorted.begin()));
+      screening_log(components.sigma2
+                  , first_frame_above_threshold
+                  , fe_sorted);
+      // link newly admitted frames to all their neighbors below the threshold.
+      // the components do not depend on the order of links.
+      admit_frames(components.index, fe_sorted, first_frame_above_threshold);
+      {
+        std::size_t i;
+        ScreeningQuery query;
+        const ScreeningIndex& index = components.index;
+        std::vector<std::atomic<std::size_t>>& parent = components.parent;
+        #pragma omp parallel for default(none)\
+          private(i)\
+          firstprivate(n_below,first_frame_above_threshold,n_cols,query)\
+          shared(index,parent,coords,fe_sorted)\
+          schedule(dynamic,64)
+        for (i=n_below; i < first_frame_above_threshold; ++i) {
+          for (std::size_t j: high_density_neighborhood(index, query, coords, n_cols, fe_sorted, i)) {
+            if (j != i) {
+              link_components(parent, i, j);
+            }
           }
         }
       }
-      // reduce buffer data to real neighborhood structure
-      for (j=0; j < limit; ++j) {
-        if (frame_in_nh[j] > 0) {
-          nh.insert(j);
+      // name clusters in order of their root, i.e. lowest free energy
+      std::vector<std::size_t> names(first_frame_above_threshold);
+      std::size_t n_clusters = 0;
+      for (std::size_t i=0; i < first_frame_above_threshold; ++i) {
+        std::size_t root = find_component(components.parent, i);
+        if (root == i) {
+          names[i] = ++n_clusters;
+        } else {
+          names[i] = names[root];
         }
       }
-      nh.insert(i_frame);
-      return nh;
+      std::vector<std::size_t> clustering(n_rows, 0);
+      for (std::size_t i=0; i < first_frame_above_threshold; ++i) {
+        clustering[fe_sorted[i].first] = names[i];
+      }
+      return clustering;
     }
 
     double
     compute_sigma2(const Neighborhood& nh) {
       double sigma2 = 0.0;
-      for (auto match: nh) {
-        // 'first second': nearest neighbor info
-        // 'second second': squared dist to nearest neighbor
-        sigma2 += match.second.second;
+      for (float d2: nh.dist2) {
+        sigma2 += d2;
       }
       return (sigma2 / nh.size());
     }
@@ -344,17 +1459,82 @@ namespace Clustering {
     std::vector<std::size_t>
     assign_low_density_frames(const std::vector<std::size_t>& initial_clustering,
                               const Neighborhood& nh_high_dens,
-                              const std::vector<float>& free_energy) {
-      std::vector<FreeEnergy> fe_sorted = sorted_free_energies(free_energy);
-      std::vector<std::size_t> clustering(initial_clustering);
-      for (const auto& fe: fe_sorted) {
-        std::size_t id = fe.first;
-        if (clustering[id] == 0) {
-          std::size_t neighbor_id = nh_high_dens.find(id)->second.first;
-          // assign cluster of nearest neighbor with higher density
-          clustering[id] = clustering[neighbor_id];
+                              const std::vector<float>& free_energy,
+                              const std::vector<std::size_t>& original_ids) {
+      // frames are assigned in order of free energy, i.e. an unassigned frame
+      // gets the final cluster of its neighbor, if the neighbor comes first,
+      // and the neighbor's initial cluster otherwise.
+      // neighbors of lower free energy always come first, the order of
+      // frames with equal free energy is given by the sorted free energies.
+      const std::size_t n_rows = initial_clustering.size();
+      std::size_t i, j;
+      bool has_ties = false;
+      #pragma omp parallel for default(none)\
+        private(i,j)\
+        firstprivate(n_rows)\
+        shared(initial_clustering,nh_high_dens,free_energy)\
+        reduction(||:has_ties)
+      for (i=0; i < n_rows; ++i) {
+        j = nh_high_dens.ids[i];
+        if (initial_clustering[i] == 0 && j < n_rows && free_energy[j] == free_energy[i]) {
+          has_ties = true;
+        }
+      }
+      std::vector<std::size_t> position;
+      if (has_ties) {
+        std::vector<FreeEnergy> fe_sorted = sorted_free_energies(free_energy, original_ids);
+        position.resize(n_rows);
+        for (i=0; i < n_rows; ++i) {
+          position[fe_sorted[i].first] = i;
         }
       }
+      // forest of unassigned frames linked to their preceding neighbors,
+      // roots carry the cluster. frames without neighbor stay unassigned.
+      std::vector<std::size_t> parent(n_rows);
+      std::vector<std::size_t> root_cluster(n_rows);
+      #pragma omp parallel for default(none)\
+        private(i,j)\
+        firstprivate(n_rows,has_ties)\
+        shared(initial_clustering,nh_high_dens,free_energy,position,parent,root_cluster)
+      for (i=0; i < n_rows; ++i) {
+        parent[i] = i;
+        root_cluster[i] = initial_clustering[i];
+        j = nh_high_dens.ids[i];
+        if (initial_clustering[i] == 0 && j < n_rows) {
+          if (free_energy[j] < free_energy[i]
+           || (has_ties && free_energy[j] == free_energy[i] && position[j] < position[i])) {
+            parent[i] = j;
+          } else {
+            root_cluster[i] = initial_clustering[j];
+          }
+        }
+      }
+      // pointer jumping: every round halves the distance to the roots
+      std::vector<std::size_t> next_parent(n_rows);
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        #pragma omp parallel for default(none)\
+          private(i)\
+          firstprivate(n_rows)\
+          shared(parent,next_parent)\
+          reduction(||:changed)
+        for (i=0; i < n_rows; ++i) {
+          next_parent[i] = parent[parent[i]];
+          if (next_parent[i] != parent[i]) {
+            changed = true;
+          }
+        }
+        parent.swap(next_parent);
+      }
+      std::vector<std::size_t> clustering(n_rows);
+      #pragma omp parallel for default(none)\
+        private(i)\
+        firstprivate(n_rows)\
+        shared(parent,root_cluster,clustering)
+      for (i=0; i < n_rows; ++i) {
+        clustering[i] = root_cluster[parent[i]];
+      }
       return clustering;
     }
 
@@ -382,13 +1562,14 @@ namespace Clustering {
              , std::size_t
              , double
              , std::vector<FreeEnergy>
-             , std::set<std::size_t>
+             , std::vector<bool>
              , std::size_t>
     prepare_initial_clustering(const std::vector<float>& free_energy
                              , const Neighborhood& nh
                              , const float free_energy_threshold
                              , const std::size_t n_rows
-                             , const std::vector<std::size_t> initial_clusters) {
+                             , const std::vector<std::size_t> initial_clusters
+                             , const std::vector<std::size_t>& original_ids) {
       std::vector<std::size_t> clustering;
       bool have_initial_clusters = (initial_clusters.size() == n_rows);
       if (have_initial_clusters) {
@@ -397,7 +1578,7 @@ namespace Clustering {
         clustering = std::vector<std::size_t>(n_rows);
       }
       // sort lowest to highest (low free energy = high density)
-      std::vector<FreeEnergy> fe_sorted = sorted_free_energies(free_energy);
+      std::vector<FreeEnergy> fe_sorted = sorted_free_energies(free_energy, original_ids);
       // find last frame below free energy threshold
       auto lb = std::upper_bound(fe_sorted.begin()
                                , fe_sorted.end()
@@ -414,14 +1595,14 @@ namespace Clustering {
       double sigma2 = compute_sigma2(nh);
       // initialize distinct name from initial clustering
       std::size_t distinct_name = *std::max_element(clustering.begin(), clustering.end());
-      std::set<std::size_t> visited_frames = {};
+      std::vector<bool> visited_frames(first_frame_above_threshold, false);
       if (have_initial_clusters) {
         // initialize visited_frames from initial clustering
         // (with indices in order of sorted free energies)
         for (std::size_t i=0; i < first_frame_above_threshold; ++i) {
           std::size_t i_original = fe_sorted[i].first;
           if (initial_clusters[i_original] != 0) {
-            visited_frames.insert(i);
+            visited_frames[i] = true;
           }
         }
       }
@@ -454,53 +1635,278 @@ namespace Clustering {
       return clustering;
     }
 
+    std::vector<std::size_t>
+    normalized_cluster_names(std::size_t first_frame_above_threshold
+                           , std::vector<std::size_t> clustering
+                           , std::vector<FreeEnergy>& fe_sorted
+                           , ClusterForest& forest) {
+      // frames above the threshold are not part of merged clusters
+      for (std::size_t i=0; i < first_frame_above_threshold; ++i) {
+        std::size_t ndx = fe_sorted[i].first;
+        clustering[ndx] = forest.common_name[find_cluster(forest, clustering[ndx])];
+      }
+      return normalized_cluster_names(first_frame_above_threshold
+                                    , clustering
+                                    , fe_sorted);
+    }
+
+    ClusterForest
+    cluster_forest(const std::size_t max_name) {
+      ClusterForest forest;
+      forest.parent.resize(max_name+1);
+      std::iota(forest.parent.begin(), forest.parent.end(), 0);
+      forest.rank.resize(max_name+1, 0);
+      forest.common_name = forest.parent;
+      return forest;
+    }
+
+    std::size_t
+    find_cluster(ClusterForest& forest
+               , std::size_t name) {
+      std::size_t root = name;
+      while (forest.parent[root] != root) {
+        root = forest.parent[root];
+      }
+      // path compression
+      while (forest.parent[name] != root) {
+        std::size_t next = forest.parent[name];
+        forest.parent[name] = root;
+        name = next;
+      }
+      return root;
+    }
+
+    std::size_t
+    merge_clusters(ClusterForest& forest
+                 , const std::size_t name1
+                 , const std::size_t name2) {
+      std::size_t root1 = find_cluster(forest, name1);
+      std::size_t root2 = find_cluster(forest, name2);
+      if (root1 != root2) {
+        if (forest.rank[root1] < forest.rank[root2]) {
+          std::swap(root1, root2);
+        }
+        forest.parent[root2] = root1;
+        if (forest.rank[root1] == forest.rank[root2]) {
+          ++forest.rank[root1];
+        }
+        forest.common_name[root1] = std::min(forest.common_name[root1]
+                                           , forest.common_name[root2]);
+      }
+      return forest.common_name[root1];
+    }
+
+    ScreeningFiltration
+    screening_sweep(const std::vector<float>& free_energy
+                  , const Neighborhood& nh
+                  , const std::vector<float>& thresholds
+                  , const float* coords
+                  , const std::size_t n_rows
+                  , const std::size_t n_cols
+                  , const NeighborGraph::Graph* graph
+                  , const std::vector<std::size_t>& initial_clustering
+                  , const std::vector<std::size_t>& original_ids) {
+      ScreeningFiltration f;
+      f.thresholds = thresholds;
+      f.fe_sorted = sorted_free_energies(free_energy, original_ids);
+      f.names.assign(n_rows, 0);
+      // name 0: unassigned frames
+      f.parent = {0};
+      f.merge_step = {0};
+      // union by rank keeps merge tree shallow, there is no
+      // path compression since it would destroy the merge history.
+      std::vector<std::size_t> rank = {0};
+      std::vector<std::size_t> common_name = {0};
+      auto find_root = [&](std::size_t name) -> std::size_t {
+        while (f.parent[name] != name) {
+          name = f.parent[name];
+        }
+        return name;
+      };
+      const double sigma2 = compute_sigma2(nh);
+      ScreeningIndex index = screening_index(coords, n_rows, n_cols, f.fe_sorted, 4*sigma2, graph);
+      ScreeningQuery query;
+      std::vector<std::size_t> cluster_names;
+      std::size_t distinct_name = 0;
+      std::size_t n_below = 0;
+      if ( ! initial_clustering.empty()) {
+        // continue from the clusters of a lower threshold:
+        // every cluster is a root of the merge tree.
+        for (std::size_t j=0; j < n_rows; ++j) {
+          f.names[j] = initial_clustering[f.fe_sorted[j].first];
+          distinct_name = std::max(distinct_name, f.names[j]);
+          if (f.names[j] != 0) {
+            ++n_below;
+          }
+        }
+        for (std::size_t name=1; name <= distinct_name; ++name) {
+          f.parent.push_back(name);
+          f.merge_step.push_back(0);
+          rank.push_back(0);
+          common_name.push_back(name);
+        }
+      }
+      for (std::size_t k=0; k < thresholds.size(); ++k) {
+        auto lb = std::upper_bound(f.fe_sorted.begin()
+                                 , f.fe_sorted.end()
+                                 , FreeEnergy(0, thresholds[k])
+                                 , [](const FreeEnergy& d1
+                                    , const FreeEnergy& d2) -> bool {
+                                     return d1.second < d2.second;
+                                   });
+        std::size_t first_frame_above_threshold = std::max(n_below
+                                                         , (std::size_t) (lb - f.fe_sorted.begin()));
+        screening_log(sigma2
+                    , first_frame_above_threshold
+                    , f.fe_sorted);
+        // only newly admitted frames are lumped with their neighborhoods,
+        // as in the screening for a single threshold with the clusters
+        // of the previous threshold.
+        admit_frames(index, f.fe_sorted, first_frame_above_threshold);
+        for (std::size_t i=n_below; i < first_frame_above_threshold; ++i) {
+          const std::vector<std::size_t>& local_nh = high_density_neighborhood(index,
+                                                                               query,
+                                                                               coords,
+                                                                               n_cols,
+                                                                               f.fe_sorted,
+                                                                               i);
+          cluster_names.clear();
+          for (auto j: local_nh) {
+            cluster_names.push_back(common_name[find_root(f.names[j])]);
+          }
+          std::sort(cluster_names.begin(), cluster_names.end());
+          cluster_names.erase(std::unique(cluster_names.begin(), cluster_names.end())
+                            , cluster_names.end());
+          if (cluster_names.size() == 1 && cluster_names[0] != 0) {
+            continue;
+          }
+          if (cluster_names.size() > 0 && cluster_names[0] == 0) {
+            cluster_names.erase(cluster_names.begin());
+          }
+          std::size_t name;
+          if (cluster_names.size() > 0) {
+            name = cluster_names[0];
+            for (auto other_name: cluster_names) {
+              std::size_t root1 = find_root(name);
+              std::size_t root2 = find_root(other_name);
+              if (root1 != root2) {
+                if (rank[root1] < rank[root2]) {
+                  std::swap(root1, root2);
+                }
+                f.parent[root2] = root1;
+                f.merge_step[root2] = k;
+                if (rank[root1] == rank[root2]) {
+                  ++rank[root1];
+                }
+                common_name[root1] = std::min(common_name[root1], common_name[root2]);
+              }
+            }
+          } else {
+            name = ++distinct_name;
+            f.parent.push_back(name);
+            f.merge_step.push_back(0);
+            rank.push_back(0);
+            common_name.push_back(name);
+          }
+          // frames keep their first name, later merges
+          // are resolved via the merge tree.
+          for (auto j: local_nh) {
+            if (f.names[j] == 0) {
+              f.names[j] = name;
+            }
+          }
+        }
+        n_below = first_frame_above_threshold;
+        f.n_frames_below.push_back(n_below);
+      }
+      return f;
+    }
+
+    std::vector<std::size_t>
+    screening_snapshot(const ScreeningFiltration& f
+                     , const std::size_t i_threshold) {
+      const std::size_t n_rows = f.fe_sorted.size();
+      const std::size_t n_below = f.n_frames_below[i_threshold];
+      const std::size_t n_names = f.parent.size();
+      // root of every frame's name at the given threshold
+      std::vector<std::size_t> roots(n_below);
+      std::vector<std::size_t> min_name(n_names, n_names);
+      for (std::size_t i=0; i < n_below; ++i) {
+        std::size_t name = f.names[i];
+        while (f.parent[name] != name && f.merge_step[name] <= i_threshold) {
+          name = f.parent[name];
+        }
+        roots[i] = name;
+        min_name[name] = std::min(min_name[name], f.names[i]);
+      }
+      // clusters are named in order of their smallest name,
+      // as in \link Clustering::Density::normalized_cluster_names.
+      std::vector<std::size_t> new_name(n_names, 0);
+      std::size_t n_clusters = 0;
+      for (std::size_t name=0; name < n_names; ++name) {
+        if (min_name[name] < n_names) {
+          new_name[min_name[name]] = 1;
+        }
+      }
+      for (std::size_t name=0; name < n_names; ++name) {
+        if (new_name[name] != 0) {
+          new_name[name] = ++n_clusters;
+        }
+      }
+      std::vector<std::size_t> clustering(n_rows, 0);
+      for (std::size_t i=0; i < n_below; ++i) {
+        clustering[f.fe_sorted[i].first] = new_name[min_name[roots[i]]];
+      }
+      return clustering;
+    }
+
     bool
-    lump_initial_clusters(const std::set<std::size_t>& local_nh
+    lump_initial_clusters(const std::vector<std::size_t>& local_nh
                         , std::size_t& distinct_name
                         , std::vector<std::size_t>& clustering
                         , const std::vector<FreeEnergy>& fe_sorted
-                        , std::size_t first_frame_above_threshold) {
+                        , ClusterForest& forest
+                        , std::vector<std::size_t>& cluster_names) {
       bool neighboring_clusters_merged = true;
       // ... let's see if at least some of them already have a
       // designated cluster assignment
-      std::set<std::size_t> cluster_names;
+      cluster_names.clear();
       for (auto j: local_nh) {
-        cluster_names.insert(clustering[fe_sorted[j].first]);
+        cluster_names.push_back(forest.common_name[find_cluster(forest, clustering[fe_sorted[j].first])]);
       }
+      std::sort(cluster_names.begin(), cluster_names.end());
+      cluster_names.erase(std::unique(cluster_names.begin(), cluster_names.end())
+                        , cluster_names.end());
       if ( ! (cluster_names.size() == 1
-           && cluster_names.count(0) != 1)) {
+           && cluster_names[0] != 0)) {
         neighboring_clusters_merged = false;
         // remove the 'zero' state, i.e. state of unassigned frames
-        if (cluster_names.count(0) == 1) {
-          cluster_names.erase(0);
+        if (cluster_names.size() > 0 && cluster_names[0] == 0) {
+          cluster_names.erase(cluster_names.begin());
         }
         std::size_t common_name;
         if (cluster_names.size() > 0) {
           // indeed, there are already cluster assignments.
           // these should now be merged under a common name.
           // (which will be the id with smallest numerical value,
-          //  due to the properties of STL-sets).
-          common_name = (*cluster_names.begin());
+          //  since names are sorted).
+          common_name = cluster_names[0];
+          for (auto name: cluster_names) {
+            merge_clusters(forest, common_name, name);
+          }
         } else {
           // no clustering of these frames yet.
           // choose a distinct name.
           common_name = ++distinct_name;
+          forest.parent.push_back(common_name);
+          forest.rank.push_back(0);
+          forest.common_name.push_back(common_name);
         }
+        // other frames of the merged clusters are renamed
+        // when normalizing the cluster names.
         for (auto j: local_nh) {
           clustering[fe_sorted[j].first] = common_name;
         }
-        std::size_t j,ndx;
-        #pragma omp parallel for default(none) private(j,ndx)\
-                                 firstprivate(common_name,\
-                                              first_frame_above_threshold,\
-                                              cluster_names)\
-                                 shared(clustering,fe_sorted)
-        for (j=0; j < first_frame_above_threshold; ++j) {
-          ndx = fe_sorted[j].first;
-          if (cluster_names.count(clustering[ndx]) == 1) {
-            clustering[ndx] = common_name;
-          }
-        }
       }
       return neighboring_clusters_merged;
     }
@@ -520,11 +1926,171 @@ namespace Clustering {
       std::size_t n_cols;
       Clustering::logger(std::cout) << "reading coords" << std::endl;
       std::tie(coords, n_rows, n_cols) = read_coords<float>(input_file);
+      SIMD::select_instruction_set(args["simd"].as<std::string>());
+      std::string pop_engine = args["population-engine"].as<std::string>();
+      std::string nn_engine = args["nn-engine"].as<std::string>();
+      // high-dimensional data: use tiled distances, if not chosen otherwise
+      // (threshold is set at compile time, see GEMM_ENGINE in CMakeLists.txt).
+      // tile checkpoints keep the default engines, which support them.
+      if (DC_GEMM_MIN_COLS > 0 && n_cols >= DC_GEMM_MIN_COLS && ! args.count("tile-checkpoint")) {
+        if (args["population-engine"].defaulted()) {
+          pop_engine = "gemm";
+        }
+        if (args["nn-engine"].defaulted()) {
+          nn_engine = "gemm";
+        }
+        Clustering::logger(std::cout) << "using engines '" << pop_engine << "' and '" << nn_engine
+                                      << "' for " << n_cols << "-dimensional data" << std::endl;
+      }
+      if (nn_engine != "brute" && nn_engine != "kdtree" && nn_engine != "incremental" && nn_engine != "gemm" && nn_engine != "hnsw") {
+        std::cerr << "error: unknown nearest neighbor engine '" << nn_engine << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      const std::string screening_engine = args["screening-engine"].as<std::string>();
+      if (screening_engine != "sweep" && screening_engine != "components") {
+        std::cerr << "error: unknown screening engine '" << screening_engine << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      if (args["box-dims"].as<int>() < 1) {
+        std::cerr << "error: box grid needs at least one dimension (--box-dims)." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      const std::size_t n_box_dims = args["box-dims"].as<int>();
+      const bool prefilter = args["prefilter"].as<bool>();
+      if (args["pivots"].as<int>() < 0) {
+        std::cerr << "error: number of pivots (--pivots) must not be negative." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      const std::size_t n_pivots = args["pivots"].as<int>();
+      const bool partial_distances = args["partial-distances"].as<bool>();
+      LSH::Parameters lsh_params = LSH::DEFAULT_PARAMETERS;
+      if (pop_engine == "lsh") {
+        if (args["lsh-tables"].as<int>() < 1 || args["lsh-hashes"].as<int>() < 1) {
+          std::cerr << "error: LSH needs at least one table (--lsh-tables) and one hash per table (--lsh-hashes)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        if ( ! (args["lsh-width"].as<float>() > 0.0f) || args["lsh-samples"].as<int>() < 0) {
+          std::cerr << "error: LSH needs a positive bucket width (--lsh-width) and a non-negative number of samples (--lsh-samples)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        lsh_params.n_tables = args["lsh-tables"].as<int>();
+        lsh_params.n_hashes = args["lsh-hashes"].as<int>();
+        lsh_params.bucket_width = args["lsh-width"].as<float>();
+        lsh_params.n_samples = args["lsh-samples"].as<int>();
+      }
+      HNSW::Parameters hnsw_params = HNSW::DEFAULT_PARAMETERS;
+      if (nn_engine == "hnsw") {
+        if (args["hnsw-links"].as<int>() < 2 || args["hnsw-ef-construction"].as<int>() < 1 || args["hnsw-ef"].as<int>() < 1) {
+          std::cerr << "error: HNSW needs at least two links per frame (--hnsw-links) and positive"
+                    << " beam widths (--hnsw-ef-construction, --hnsw-ef)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        if (args["hnsw-samples"].as<int>() < 0) {
+          std::cerr << "error: HNSW needs a non-negative number of samples (--hnsw-samples)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        hnsw_params.n_links = args["hnsw-links"].as<int>();
+        hnsw_params.ef_construction = args["hnsw-ef-construction"].as<int>();
+        hnsw_params.ef_search = args["hnsw-ef"].as<int>();
+        hnsw_params.n_samples = args["hnsw-samples"].as<int>();
+      }
+      //// tile checkpoints of population ('boxes' engine)
+      //// and nearest neighbor ('brute' and 'kdtree' engines) computations
+      Tiles::Parameters pop_tiles = Tiles::DEFAULT_PARAMETERS;
+      Tiles::Parameters nn_tiles = Tiles::DEFAULT_PARAMETERS;
+      if (args.count("tile-checkpoint")) {
+        if (args["tile-size"].as<int>() < 1) {
+          std::cerr << "error: tiles need at least one frame (--tile-size)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        const std::string basename = args["tile-checkpoint"].as<std::string>();
+        pop_tiles.tile_size = nn_tiles.tile_size = args["tile-size"].as<int>();
+        pop_tiles.resume = nn_tiles.resume = args["tile-resume"].as<bool>();
+        if (pop_engine == "boxes") {
+          pop_tiles.filename = basename + ".pop";
+        } else {
+          std::cerr << "warning: population computation with engine '" << pop_engine
+                    << "' is not checkpointed (only with engine 'boxes')." << std::endl;
+        }
+        if (nn_engine == "brute" || nn_engine == "kdtree") {
+          nn_tiles.filename = basename + ".nn";
+        } else {
+          std::cerr << "warning: nearest neighbor computation with engine '" << nn_engine
+                    << "' is not checkpointed (only with engines 'brute' and 'kdtree')." << std::endl;
+        }
+        if (args.count("neighbor-graph") || args.count("neighbor-graph-input")) {
+          std::cerr << "warning: computations on the neighbor graph are not checkpointed." << std::endl;
+        }
+      }
+      // fingerprint of the coordinates in original frame order:
+      // neighbor graphs are only reused for the same data.
+      uint64_t graph_fingerprint = 0;
+      if (args.count("neighbor-graph") || args.count("neighbor-graph-input")) {
+        const uint64_t dims[2] = {n_rows, n_cols};
+        graph_fingerprint = Tiles::fingerprint(dims, sizeof(dims));
+        graph_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float), graph_fingerprint);
+      }
+      //// space-filling curve reordering:
+      //// all computations run on reordered frames,
+      //// while inputs and outputs are kept in original frame order.
+      std::vector<std::size_t> order;
+      const std::string curve = args["reorder"].as<std::string>();
+      if (curve != "none") {
+        if (args["reorder-dims"].as<int>() < 1) {
+          std::cerr << "error: space-filling curve needs at least one dimension (--reorder-dims)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        if (args["reorder-dims"].as<int>() > (int) MAX_CURVE_DIMS) {
+          std::cerr << "error: space-filling curve spans at most " << MAX_CURVE_DIMS
+                    << " dimensions (--reorder-dims)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        Clustering::logger(std::cout) << "reordering frames along " << curve << " curve" << std::endl;
+        order = space_filling_curve_order(coords
+                                        , n_rows
+                                        , n_cols
+                                        , curve
+                                        , args["reorder-dims"].as<int>());
+        float* curve_coords = reordered_coords(coords, n_rows, n_cols, order);
+        free_coords(coords);
+        coords = curve_coords;
+      }
+      //// neighbor graph:
+      //// shared by population, nearest neighbor and screening computations.
+      NeighborGraph::Graph graph;
+      const bool use_graph = args.count("neighbor-graph") || args.count("neighbor-graph-input");
+      if (args.count("neighbor-graph-input")) {
+        Clustering::logger(std::cout) << "re-using neighbor graph." << std::endl;
+        // checked for number of frames and data before reordering
+        graph = NeighborGraph::reordered(NeighborGraph::read_graph(args["neighbor-graph-input"].as<std::string>()
+                                                                 , n_rows
+                                                                 , graph_fingerprint)
+                                       , order);
+      } else if (use_graph) {
+        float cutoff = 0.0f;
+        if (args.count("neighbor-graph-cutoff")) {
+          cutoff = args["neighbor-graph-cutoff"].as<float>();
+        } else if (args.count("radii")) {
+          std::vector<float> radii = args["radii"].as<std::vector<float>>();
+          cutoff = *std::max_element(radii.begin(), radii.end());
+        } else if (args.count("radius")) {
+          cutoff = args["radius"].as<float>();
+        }
+        if ( ! (cutoff > 0.0f)) {
+          std::cerr << "error: neighbor graph needs a positive cutoff (--neighbor-graph-cutoff, -R or -r)." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        Clustering::logger(std::cout) << "building neighbor graph with cutoff " << cutoff << std::endl;
+        graph = NeighborGraph::build_graph(coords, n_rows, n_cols, cutoff, n_box_dims);
+      }
+      if (args.count("neighbor-graph")) {
+        NeighborGraph::write_graph(args["neighbor-graph"].as<std::string>(), NeighborGraph::original_order(graph, order), graph_fingerprint);
+      }
       //// free energies
       std::vector<float> free_energies;
       if (args.count("free-energy-input")) {
         Clustering::logger(std::cout) << "re-using free energy data." << std::endl;
-        free_energies = read_free_energies(args["free-energy-input"].as<std::string>());
+        free_energies = reordered(read_free_energies(args["free-energy-input"].as<std::string>()), order);
       } else if (args.count("free-energy") || args.count("population") || args.count("output")) {
         if (args.count("radii")) {
           // compute populations & free energies for different radii in one go
@@ -537,25 +2103,30 @@ namespace Clustering {
             exit(EXIT_FAILURE);
           }
           std::vector<float> radii = args["radii"].as<std::vector<float>>();
-#ifdef USE_CUDA
-          Pops pops = Clustering::Density::CUDA::calculate_populations(coords
-                                                                     , n_rows
-                                                                     , n_cols
-                                                                     , radii);
-#else
-          Pops pops = calculate_populations(coords
-                                          , n_rows
-                                          , n_cols
-                                          , radii);
-#endif
+          Pops pops;
+          if (use_graph && *std::max_element(radii.begin(), radii.end()) <= graph.cutoff) {
+            pops = NeighborGraph::calculate_populations(graph, radii);
+          } else {
+            pops = calculate_populations(coords
+                                       , n_rows
+                                       , n_cols
+                                       , radii
+                                       , pop_engine
+                                       , n_box_dims
+                                       , prefilter
+                                       , n_pivots
+                                       , partial_distances
+                                       , lsh_params
+                                       , pop_tiles);
+          }
           for (auto radius_pops: pops) {
             if (args.count("population")) {
               std::string basename_pop = args["population"].as<std::string>() + "_%f";
-              write_pops(Clustering::Tools::stringprintf(basename_pop, radius_pops.first), radius_pops.second);
+              write_pops(Clustering::Tools::stringprintf(basename_pop, radius_pops.first), original_order(radius_pops.second, order));
             }
             if (args.count("free-energy")) {
               std::string basename_fe = args["free-energy"].as<std::string>() + "_%f";
-              write_fes(Clustering::Tools::stringprintf(basename_fe, radius_pops.first), calculate_free_energies(radius_pops.second));
+              write_fes(Clustering::Tools::stringprintf(basename_fe, radius_pops.first), original_order(calculate_free_energies(radius_pops.second), order));
             }
           }
         } else {
@@ -565,14 +2136,19 @@ namespace Clustering {
           const float radius = args["radius"].as<float>();
           // compute populations & free energies for clustering and/or saving
           Clustering::logger(std::cout) << "calculating populations" << std::endl;
-          std::vector<std::size_t> pops = calculate_populations(coords, n_rows, n_cols, radius);
+          std::vector<std::size_t> pops;
+          if (use_graph && radius <= graph.cutoff) {
+            pops = NeighborGraph::calculate_populations(graph, {radius})[radius];
+          } else {
+            pops = calculate_populations(coords, n_rows, n_cols, {radius}, pop_engine, n_box_dims, prefilter, n_pivots, partial_distances, lsh_params, pop_tiles)[radius];
+          }
           if (args.count("population")) {
-            write_pops(args["population"].as<std::string>(), pops);
+            write_pops(args["population"].as<std::string>(), original_order(pops, order));
           }
           Clustering::logger(std::cout) << "calculating free energies" << std::endl;
           free_energies = calculate_free_energies(pops);
           if (args.count("free-energy")) {
-            write_fes(args["free-energy"].as<std::string>(), free_energies);
+            write_fes(args["free-energy"].as<std::string>(), original_order(free_energies, order));
           }
         }
       }
@@ -582,8 +2158,8 @@ namespace Clustering {
       if (args.count("nearest-neighbors-input")) {
         Clustering::logger(std::cout) << "re-using nearest neighbor data." << std::endl;
         auto nh_pair = read_neighborhood(args["nearest-neighbors-input"].as<std::string>());
-        nh = nh_pair.first;
-        nh_high_dens = nh_pair.second;
+        nh = reordered(nh_pair.first, order);
+        nh_high_dens = reordered(nh_pair.second, order);
       } else if (args.count("nearest-neighbors") || args.count("output")) {
         Clustering::logger(std::cout) << "calculating nearest neighbors" << std::endl;
         if ( ! args.count("radius")) {
@@ -595,12 +2171,27 @@ namespace Clustering {
                                                                    , n_cols
                                                                    , free_energies);
 #else
-        auto nh_tuple = nearest_neighbors(coords, n_rows, n_cols, free_energies);
+        std::tuple<Neighborhood, Neighborhood> nh_tuple;
+        if (use_graph) {
+          nh_tuple = NeighborGraph::nearest_neighbors(graph, coords, n_rows, n_cols, free_energies, order);
+        } else if (nn_engine == "kdtree") {
+          nh_tuple = Clustering::Density::KDTree::nearest_neighbors(coords, n_rows, n_cols, free_energies, nn_tiles, order);
+        } else if (nn_engine == "gemm") {
+          nh_tuple = Clustering::Density::GEMM::nearest_neighbors(coords, n_rows, n_cols, free_energies, order);
+        } else if (nn_engine == "incremental") {
+          nh_tuple = Clustering::Density::KDTree::nearest_neighbors_incremental(coords, n_rows, n_cols, free_energies, order);
+        } else if (nn_engine == "hnsw") {
+          nh_tuple = Clustering::Density::HNSW::nearest_neighbors(coords, n_rows, n_cols, free_energies, hnsw_params);
+        } else {
+          nh_tuple = nearest_neighbors(coords, n_rows, n_cols, free_energies, prefilter, n_pivots, partial_distances, nn_tiles, order);
+        }
 #endif
         nh = std::get<0>(nh_tuple);
         nh_high_dens = std::get<1>(nh_tuple);
         if (args.count("nearest-neighbors")) {
-          Clustering::Tools::write_neighborhood(args["nearest-neighbors"].as<std::string>(), nh, nh_high_dens);
+          Clustering::Tools::write_neighborhood(args["nearest-neighbors"].as<std::string>()
+                                              , original_order(nh, order)
+                                              , original_order(nh_high_dens, order));
         }
       }
       //// clustering
@@ -614,7 +2205,7 @@ namespace Clustering {
         std::vector<std::size_t> clustering;
         if (args.count("input")) {
           Clustering::logger(std::cout) << "reading initial clusters from file." << std::endl;
-          clustering = read_clustered_trajectory(args["input"].as<std::string>());
+          clustering = reordered(read_clustered_trajectory(args["input"].as<std::string>()), order);
         }
         if (args.count("threshold-screening")) {
           std::vector<float> threshold_params = args["threshold-screening"].as<std::vector<float>>();
@@ -639,25 +2230,120 @@ namespace Clustering {
           // circumvent rounding errors when comparing on equality
           float t_to_low = t_to - t_step/10.0f + t_step;
           float t_to_high = t_to + t_step/10.0f + t_step;
+          std::vector<float> thresholds;
           for (float t=t_from; (t < t_to_low) && !(t_to_high < t); t += t_step) {
+            thresholds.push_back(t);
+          }
+          // engines without initial states run on all frames below the threshold,
+          // the chained screening re-uses the clusters of the previous threshold.
+          const bool initial_states = ! clustering.empty();
+          //// checkpointing: state after every N thresholds is saved,
+          //// an interrupted screening is resumed from the last checkpoint.
+          const bool use_checkpoint = args.count("screening-checkpoint");
+          std::size_t checkpoint_interval = thresholds.size();
+          std::size_t n_done = 0;
+          if (use_checkpoint) {
+            const std::string checkpoint_file = args["screening-checkpoint"].as<std::string>();
+            if (args["screening-checkpoint-interval"].as<int>() < 1) {
+              std::cerr << "error: checkpoint interval must be at least one threshold (--screening-checkpoint-interval)." << std::endl;
+              exit(EXIT_FAILURE);
+            }
+            checkpoint_interval = args["screening-checkpoint-interval"].as<int>();
+            if (args["screening-resume"].as<bool>() && std::ifstream(checkpoint_file).good()) {
+              ScreeningCheckpoint checkpoint = read_screening_checkpoint(checkpoint_file);
+              if (checkpoint.clustering.size() != n_rows
+               || checkpoint.n_thresholds > thresholds.size()
+               || (checkpoint.n_thresholds > 0
+                && std::abs(thresholds[checkpoint.n_thresholds-1] - checkpoint.threshold) > t_step/10.0f)) {
+                std::cerr << "error: screening checkpoint '" << checkpoint_file
+                          << "' does not match the given data and thresholds." << std::endl;
+                exit(EXIT_FAILURE);
+              }
+              n_done = checkpoint.n_thresholds;
+              if (n_done > 0) {
+                Clustering::logger(std::cout) << "resuming screening after threshold "
+                                              << checkpoint.threshold << std::endl;
+                clustering = reordered(checkpoint.clustering, order);
+              }
+            } else if (args["screening-resume"].as<bool>()) {
+              Clustering::logger(std::cout) << "no screening checkpoint found, starting from first threshold" << std::endl;
+            }
+          }
+          auto save_checkpoint = [&](std::size_t n_thresholds
+                                   , const std::vector<std::size_t>& current_clustering) {
+            if (use_checkpoint
+             && (n_thresholds % checkpoint_interval == 0 || n_thresholds == thresholds.size())) {
+              write_screening_checkpoint(args["screening-checkpoint"].as<std::string>()
+                                       , {n_thresholds
+                                        , thresholds[n_thresholds-1]
+                                        , original_order(current_clustering, order)});
+            }
+          };
+#ifndef USE_CUDA
+          if ( ! initial_states && screening_engine == "components") {
+            // parallel connected components, growing with the thresholds
+            ScreeningComponents components = screening_components(free_energies
+                                                                , nh
+                                                                , coords
+                                                                , n_rows
+                                                                , n_cols
+                                                                , use_graph ? &graph : nullptr
+                                                                , clustering
+                                                                , order);
+            for (std::size_t k=n_done; k < thresholds.size(); ++k) {
+              clustering = screening_components_step(components, thresholds[k], coords, n_cols);
+              write_single_column(Clustering::Tools::stringprintf(output_file + ".%0.2f", thresholds[k])
+                                , original_order(clustering, order));
+              save_checkpoint(k+1, clustering);
+            }
+            n_done = thresholds.size();
+          } else if ( ! initial_states) {
+            // single sweep over all thresholds, split at checkpoints
+            while (n_done < thresholds.size()) {
+              std::size_t n_sweep = std::min(checkpoint_interval - n_done % checkpoint_interval
+                                           , thresholds.size() - n_done);
+              ScreeningFiltration filtration = screening_sweep(free_energies
+                                                             , nh
+                                                             , std::vector<float>(thresholds.begin() + n_done
+                                                                                , thresholds.begin() + n_done + n_sweep)
+                                                             , coords
+                                                             , n_rows
+                                                             , n_cols
+                                                             , use_graph ? &graph : nullptr
+                                                             , clustering
+                                                             , order);
+              for (std::size_t k=0; k < n_sweep; ++k) {
+                clustering = screening_snapshot(filtration, k);
+                write_single_column(Clustering::Tools::stringprintf(output_file + ".%0.2f", thresholds[n_done+k])
+                                  , original_order(clustering, order));
+              }
+              n_done += n_sweep;
+              save_checkpoint(n_done, clustering);
+            }
+          }
+#endif
+          for (std::size_t k=n_done; k < thresholds.size(); ++k) {
             // compute clusters, re-using old results from previous step
             clustering = screening(free_energies
                                  , nh
-                                 , t
+                                 , thresholds[k]
                                  , coords
                                  , n_rows
                                  , n_cols
-                                 , clustering);
-            write_single_column(Clustering::Tools::stringprintf(output_file + ".%0.2f", t)
-                              , clustering);
+                                 , clustering
+                                 , order);
+            write_single_column(Clustering::Tools::stringprintf(output_file + ".%0.2f", thresholds[k])
+                              , original_order(clustering, order));
+            save_checkpoint(k+1, clustering);
           }
         } else {
           Clustering::logger(std::cout) << "assigning low density states to initial clusters" << std::endl;
           clustering = assign_low_density_frames(clustering
                                                , nh_high_dens
-                                               , free_energies);
+                                               , free_energies
+                                               , order);
           Clustering::logger(std::cout) << "writing clusters to file " << output_file << std::endl;
-          write_single_column<std::size_t>(output_file, clustering);
+          write_single_column<std::size_t>(output_file, original_order(clustering, order));
         }
       }
       Clustering::logger(std::cout) << "freeing coords" << std::endl;
@@ -31,10 +31,13 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <array>
 #include <utility>
 #include <string>
+#include <atomic>
 
 #include <boost/program_options.hpp>
 
 #include "tools.hpp"
+#include "density_clustering_lsh.hpp"
+#include "density_clustering_tiles.hpp"
 
 //! general namespace for clustering package
 namespace Clustering {
@@ -46,56 +49,177 @@ namespace Clustering {
     using Neighbor = Clustering::Tools::Neighbor;
     //! map frame id to neighbors
     using Neighborhood = Clustering::Tools::Neighborhood;
-    //! encodes 2D box for box-assisted search algorithm
-    using Box = std::array<int, 2>;
-    //! encodes box differences in 2D, i.e. if you are at
-    //! the center box, the 9 different tuples hold the steppings
-    //! to the 9 spacial neighbors (including the center box itself).
-    constexpr int BOX_DIFF[9][2] = {{-1, 1}, { 0, 1}, { 1, 1}
-                                  , {-1, 0}, { 0, 0}, { 1, 0}
-                                  , {-1,-1}, { 0,-1}, { 1,-1}};
-    //! number of neigbor boxes in 2D grid (including center box).
-    const int N_NEIGHBOR_BOXES = 9;
-//    //! encodes box differences in 3D, i.e. if you are at
-//    //! the center box, the 27 different tuples hold the steppings
-//    //! to the 27 spacial neighbors (including the center box itself).
-//    constexpr int BOX_DIFF[27][3] = {{-1, 1,-1}, { 0, 1,-1}, { 1, 1,-1}
-//                                   , {-1, 0,-1}, { 0, 0,-1}, { 1, 0,-1}
-//                                   , {-1,-1,-1}, { 0,-1,-1}, { 1,-1,-1}
-//                                   , {-1, 1, 0}, { 0, 1, 0}, { 1, 1, 0}
-//                                   , {-1, 0, 0}, { 0, 0, 0}, { 1, 0, 0}
-//                                   , {-1,-1, 0}, { 0,-1, 0}, { 1,-1, 0}
-//                                   , {-1, 1, 1}, { 0, 1, 1}, { 1, 1, 1}
-//                                   , {-1, 0, 1}, { 0, 0, 1}, { 1, 0, 1}
-//                                   , {-1,-1, 1}, { 0,-1, 1}, { 1,-1, 1}};
-//    //! number of neigbor boxes in cubic 3D grid (including center box).
-//    const int N_NEIGHBOR_BOXES = 27;
+    //! encodes n-dimensional box for box-assisted search algorithm
+    using Box = std::vector<int>;
+    //! default number of dimensions used for the box grid
+    const std::size_t DEFAULT_BOX_DIMS = 2;
+    //! default number of dimensions for space-filling curve reordering
+    const std::size_t DEFAULT_CURVE_DIMS = 3;
+    //! max. number of dimensions for space-filling curve reordering,
+    //! i.e. at least one bit per dimension of the 64-bit curve index
+    const std::size_t MAX_CURVE_DIMS = 64;
+    namespace NeighborGraph {
+      struct Graph;
+    } // end namespace NeighborGraph
     //! the full grid constructed for boxed-assisted nearest neighbor
     //! search with fixed distance criterion.
+    //! only non-empty boxes are stored. frames are kept in compressed
+    //! sparse row (CSR) format, i.e. the frames of the i-th box are
+    //! frames[box_offsets[i]] ... frames[box_offsets[i+1]-1].
     struct BoxGrid {
-      //! total number of boxes
+      //! number of box dimensions
+      std::size_t n_dims;
+      //! number of boxes per dimension
       std::vector<int> n_boxes;
-      //! matching frame id to the frame's assigned box
-      std::vector<Box> assigned_box;
-      //! the boxes with a list of assigned frame ids
-      std::map<Box, std::vector<int>> boxes;
+      //! strides to compute linear box id from box coordinates
+      std::vector<std::size_t> strides;
+      //! linear ids of non-empty boxes (sorted ascending)
+      std::vector<std::size_t> box_ids;
+      //! box coordinates of non-empty boxes, format: [i_box * n_dims + dim]
+      std::vector<int> box_coords;
+      //! offsets of non-empty boxes into 'frames' (n+1 entries)
+      std::vector<std::size_t> box_offsets;
+      //! frame ids sorted by their box
+      std::vector<std::size_t> frames;
+      //! matching frame id to the frame's assigned (non-empty) box
+      std::vector<std::size_t> assigned_box;
+      //! steppings from center box to its spatial neighbors
+      //! (including the center box itself).
+      std::vector<Box> box_diffs;
     };
-    //! returns neighbor box given by neighbor index (in 3D: 27 different neighbors, including center itself)
-    //! and the given center box.
-    constexpr Box
-    neighbor_box(const Box center, const int i_neighbor);
+    //! disjoint-set forest (union-find) over cluster names of the
+    //! screening process: merged clusters share a root, frames keep
+    //! their old names until the names are normalized.
+    struct ClusterForest {
+      //! parent name of every name (roots are their own parent)
+      std::vector<std::size_t> parent;
+      //! upper bound of tree height, per root
+      std::vector<std::size_t> rank;
+      //! name of the merged cluster, i.e. smallest name in its set, per root
+      std::vector<std::size_t> common_name;
+    };
+    //! incrementally growing box grid over the frames admitted to the
+    //! screening (in order of free energy) for neighborhood queries
+    //! with fixed distance criterion.
+    struct ScreeningIndex {
+      //! grid over all frames, boxes are slightly wider than the query radius
+      BoxGrid grid;
+      //! squared query radius
+      float max_dist;
+      //! number of admitted frames, i.e. the first frames of sorted free energies
+      std::size_t n_admitted;
+      //! all frames (indices of sorted free energies) grouped by box
+      //! as given by 'grid.box_offsets', ascending per box.
+      //! thus, the admitted frames of a box are the first ones of its range.
+      std::vector<std::size_t> box_frames;
+      //! number of admitted frames per non-empty box
+      std::vector<std::size_t> n_box_admitted;
+      //! neighbor graph (if not null) replaces the grid: neighborhoods are
+      //! read from the graph without any distance computations.
+      const NeighborGraph::Graph* graph;
+      //! index in sorted free energies of every frame (graph queries only)
+      std::vector<std::size_t> sorted_position;
+    };
+    //! buffers of neighborhood queries on a ScreeningIndex,
+    //! one per thread for concurrent queries.
+    struct ScreeningQuery {
+      //! result of the last query (ascending)
+      std::vector<std::size_t> neighbors;
+      std::vector<std::size_t> neighbor_boxes;
+      std::vector<std::size_t> candidates;
+      std::vector<std::size_t> candidate_ids;
+      std::vector<float> dist2;
+    };
+    //! state of the connected components screening over increasing thresholds.
+    //! clusters are the connected components of the graph of all frames below
+    //! the threshold, linking frames closer than the 4*sigma2 distance criterion.
+    struct ScreeningComponents {
+      //! free energies sorted lowest to highest
+      std::vector<FreeEnergy> fe_sorted;
+      double sigma2;
+      ScreeningIndex index;
+      //! concurrent union-find forest over frames (indices of sorted free energies).
+      //! frames are linked to frames of lower index only, i.e. every component's
+      //! root is its frame of lowest free energy.
+      std::vector<std::atomic<std::size_t>> parent;
+    };
+    //! merge history of clusters over increasing free energy thresholds,
+    //! recorded by a single sweep over the frames in order of free energy.
+    //! cluster names form a merge tree: a name belongs to the cluster of its
+    //! parent for all thresholds from its 'merge_step' on.
+    struct ScreeningFiltration {
+      //! free energy thresholds in ascending order
+      std::vector<float> thresholds;
+      //! free energies sorted lowest to highest
+      std::vector<FreeEnergy> fe_sorted;
+      //! number of frames below every threshold
+      std::vector<std::size_t> n_frames_below;
+      //! cluster name given to every frame (in order of sorted free energies)
+      std::vector<std::size_t> names;
+      //! parent of every name in the merge tree (roots are their own parent)
+      std::vector<std::size_t> parent;
+      //! index of the threshold at which a name got merged into its parent
+      std::vector<std::size_t> merge_step;
+    };
+    //! state of a threshold screening for resuming interrupted runs.
+    //! all screening engines continue from the clusters
+    //! of the last completed threshold.
+    struct ScreeningCheckpoint {
+      //! number of completed thresholds
+      std::size_t n_thresholds;
+      //! last completed threshold
+      float threshold;
+      //! clustered trajectory of the last completed threshold
+      std::vector<std::size_t> clustering;
+    };
+    //! encodes box differences in n dimensions, i.e. if you are at
+    //! the center box, the 3^n different tuples hold the steppings
+    //! to the 3^n spacial neighbors (including the center box itself).
+    std::vector<Box>
+    neighbor_box_diffs(const std::size_t n_dims);
     //! uses fixed radius to separate coordinate space in equally sized
     //! boxes for box-assisted nearest neighbor search.
+    //! boxes are defined on the first 'n_box_dims' columns
+    //! (limited by the number of columns).
+    //! box coordinates are rounded, i.e. for neighbor searches with
+    //! fixed radius the boxes must be slightly wider than the radius.
     BoxGrid
     compute_box_grid(const float* coords,
                      const std::size_t n_rows,
                      const std::size_t n_cols,
-                     const float radius);
-    //! returns true, if the box is a valid box in the grid.
-    //! return false, if the box is outside of the grid.
-    bool
-    is_valid_box(const Box box,
-                 const BoxGrid& grid);
+                     const float radius,
+                     const std::size_t n_box_dims = DEFAULT_BOX_DIMS);
+    //! writes the indices of all non-empty neighbor boxes of box 'i_box'
+    //! (including the box itself) to 'neighbors', in ascending order.
+    //! the buffer is re-used to avoid memory allocations.
+    void
+    neighbor_boxes(const BoxGrid& grid,
+                   const std::size_t i_box,
+                   std::vector<std::size_t>& neighbors);
+    //! copy of coordinates in order of grid.frames, i.e. frames
+    //! of the same box are adjacent in memory.
+    std::vector<float>
+    box_sorted_coords(const float* coords,
+                      const std::size_t n_cols,
+                      const BoxGrid& grid);
+    //! frame ids ordered along a space-filling curve ('morton' or 'hilbert')
+    //! through the first 'n_curve_dims' columns (limited by the number of columns).
+    //! frames close in space are mostly close in the resulting order, which
+    //! improves cache locality of all neighbor searches on reordered coordinates.
+    //! frames in the same curve cell keep their original order.
+    std::vector<std::size_t>
+    space_filling_curve_order(const float* coords,
+                              const std::size_t n_rows,
+                              const std::size_t n_cols,
+                              const std::string curve,
+                              const std::size_t n_curve_dims = DEFAULT_CURVE_DIMS);
+    //! id deciding between neighbors of equal distance: the id of frame 'i'
+    //! in the original frame order ('original_ids' as given by
+    //! space_filling_curve_order, empty if frames have not been reordered).
+    //! neighbors thus do not depend on the order of frames.
+    std::size_t
+    tie_id(const std::vector<std::size_t>& original_ids,
+           const std::size_t i);
     //! calculate population of n-dimensional hypersphere per frame for one fixed radius.
     std::vector<std::size_t>
     calculate_populations(const float* coords,
@@ -105,66 +229,235 @@ namespace Clustering {
     //! calculate populations of n-dimensional hypersphere per frame for
     //! different radii in one go. computationally much more efficient than
     //! running single-radius version for every radius.
+    //! the box grid is built on the first 'n_box_dims' columns.
+    //! with a checkpoint file, boxes are processed in tiles
+    //! that are saved when finished (see Clustering::Density::Tiles).
     std::map<float, std::vector<std::size_t>>
     calculate_populations(const float* coords,
                           const std::size_t n_rows,
                           const std::size_t n_cols,
-                          const std::vector<float> radii);
+                          const std::vector<float> radii,
+                          const std::size_t n_box_dims = DEFAULT_BOX_DIMS,
+                          const bool prefilter = false,
+                          const std::size_t n_pivots = 0,
+                          const bool partial_distances = false,
+                          const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS);
+    //! calculate populations for many radii in a single pass over all pairs.
+    //! for every frame, its neighbors are binned into a histogram over the
+    //! radius intervals (one increment per pair, independent of the number
+    //! of radii). the cumulative sums of the histogram give the frame's
+    //! population profile, from which the populations for all radii are taken.
+    //! uses the box grid on the first 'n_box_dims' columns for the largest radius.
+    std::map<float, std::vector<std::size_t>>
+    calculate_population_profiles(const float* coords,
+                                  const std::size_t n_rows,
+                                  const std::size_t n_cols,
+                                  std::vector<float> radii,
+                                  const std::size_t n_box_dims = DEFAULT_BOX_DIMS,
+                                  const bool prefilter = false,
+                                  const std::size_t n_pivots = 0,
+                                  const bool partial_distances = false);
+    //! calculate populations for different radii with the given engine:
+    //!   - 'boxes': box-assisted search on the first 'n_box_dims' dimensions
+    //!   - 'kdtree': k-d tree, pruning on all dimensions
+    //!   - 'profile': box-assisted single-pass population profiles,
+    //!                for scans over many radii
+    //!   - 'gemm': tiled distances via matrix products, for high-dimensional data
+    //!   - 'lsh': approximate populations via locality-sensitive hashing
+    //!            with parameters 'lsh_params' (see Clustering::Density::LSH)
+    //! all engines but 'lsh' return exactly the same results.
+    //! with 'prefilter', the box-based engines decide most pairs on 8-bit
+    //! compressed coordinates (see Clustering::Density::Prefilter).
+    //! with 'n_pivots' > 0, they additionally decide pairs by the triangle
+    //! inequality on distances to pivot frames (see Clustering::Density::Pivots).
+    //! with 'partial_distances', they reject pairs early on partial sums over
+    //! variance-ordered columns (see Clustering::Density::PartialDistances).
+    //! the 'boxes' engine saves finished tiles to the checkpoint file of 'tiles'.
+    //! (for CUDA-enabled builds, the engine setting is ignored)
+    std::map<float, std::vector<std::size_t>>
+    calculate_populations(const float* coords,
+                          const std::size_t n_rows,
+                          const std::size_t n_cols,
+                          const std::vector<float> radii,
+                          const std::string engine,
+                          const std::size_t n_box_dims,
+                          const bool prefilter = false,
+                          const std::size_t n_pivots = 0,
+                          const bool partial_distances = false,
+                          const LSH::Parameters& lsh_params = LSH::DEFAULT_PARAMETERS,
+                          const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS);
     //! re-use populations to calculate local free energy estimate
     //! via $\Delta G = -k_B T \\ln(P)$.
     std::vector<float>
     calculate_free_energies(const std::vector<std::size_t>& pops);
     //! returns the given free energies sorted lowest to highest.
-    //! original indices are retained.
+    //! original indices are retained. with 'original_ids' (see tie_id),
+    //! equal free energies are in the same order as without reordering.
     std::vector<FreeEnergy>
-    sorted_free_energies(const std::vector<float>& fe);
+    sorted_free_energies(const std::vector<float>& fe,
+                         const std::vector<std::size_t>& original_ids = {});
     //! for every frame: compute the nearest neighbor (first tuple field)
     //! and the nearest neighbor with lower free energy, i.e. higher density (second tuple field).
+    //! with 'prefilter' or 'n_pivots' > 0, frames are skipped if the distance
+    //! bounds from compressed coordinates or pivots exclude them as neighbors.
+    //! with 'partial_distances', distances are abandoned early on variance-ordered
+    //! columns if they exceed the current neighbor distances.
+    //! with a checkpoint file, frames are processed in tiles
+    //! that are saved when finished (see Clustering::Density::Tiles).
+    //! neighbors of equal distance are decided by their ids in
+    //! 'original_ids' (see tie_id), else by the lowest frame id.
     std::tuple<Neighborhood, Neighborhood>
     nearest_neighbors(const float* coords,
                       const std::size_t n_rows,
                       const std::size_t n_cols,
-                      const std::vector<float>& free_energy);
+                      const std::vector<float>& free_energy,
+                      const bool prefilter = false,
+                      const std::size_t n_pivots = 0,
+                      const bool partial_distances = false,
+                      const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS,
+                      const std::vector<std::size_t>& original_ids = {});
     //! log output for screening steps
     void
     screening_log(const double sigma2
                 , const std::size_t first_frame_above_threshold
                 , const std::vector<FreeEnergy>& fe_sorted);
     //! prepare data for initial density clustering as used
-    //! in the screening process
+    //! in the screening process.
+    //! visited frames are flagged in order of sorted free energies.
     std::tuple<std::vector<std::size_t>
              , std::size_t
              , double
              , std::vector<FreeEnergy>
-             , std::set<std::size_t>
+             , std::vector<bool>
              , std::size_t>
     prepare_initial_clustering(const std::vector<float>& free_energy
                              , const Neighborhood& nh
                              , const float free_energy_threshold
                              , const std::size_t n_rows
-                             , const std::vector<std::size_t> initial_clusters);
+                             , const std::vector<std::size_t> initial_clusters
+                             , const std::vector<std::size_t>& original_ids = {});
     //! return clustered trajectory with new, distinct cluster names.
     std::vector<std::size_t>
     normalized_cluster_names(std::size_t first_frame_above_threshold
                            , std::vector<std::size_t> clustering
                            , std::vector<FreeEnergy>& fe_sorted);
-    //! lump clusters based on distance threshold in screening process
+    //! return clustered trajectory with new, distinct cluster names,
+    //! after renaming frames below the threshold to their merged clusters.
+    std::vector<std::size_t>
+    normalized_cluster_names(std::size_t first_frame_above_threshold
+                           , std::vector<std::size_t> clustering
+                           , std::vector<FreeEnergy>& fe_sorted
+                           , ClusterForest& forest);
+    //! forest of separate clusters for names 0 ... max_name
+    ClusterForest
+    cluster_forest(const std::size_t max_name);
+    //! root of the cluster with given name (with path compression)
+    std::size_t
+    find_cluster(ClusterForest& forest
+               , std::size_t name);
+    //! merge clusters of both names (union by rank),
+    //! returns the name of the merged cluster.
+    std::size_t
+    merge_clusters(ClusterForest& forest
+                 , const std::size_t name1
+                 , const std::size_t name2);
+    //! screening for all given (ascending) thresholds in a single sweep,
+    //! i.e. free energies are sorted once and neighborhoods are computed
+    //! only once per frame. gives the same clusters as consecutive calls
+    //! of \link Clustering::Density::screening, starting without initial clusters.
+    //! the sweep may continue from the clusters of a lower threshold
+    //! (as given by a previous sweep), e.g. to resume from a checkpoint.
+    //! frames of equal free energy are handled in original frame order
+    //! ('original_ids', see tie_id).
+    ScreeningFiltration
+    screening_sweep(const std::vector<float>& free_energy
+                  , const Neighborhood& nh
+                  , const std::vector<float>& thresholds
+                  , const float* coords
+                  , const std::size_t n_rows
+                  , const std::size_t n_cols
+                  , const NeighborGraph::Graph* graph = nullptr
+                  , const std::vector<std::size_t>& initial_clustering = {}
+                  , const std::vector<std::size_t>& original_ids = {});
+    //! clustered trajectory (with normalized names) of the threshold
+    //! with given index from recorded screening sweep.
+    std::vector<std::size_t>
+    screening_snapshot(const ScreeningFiltration& filtration
+                     , const std::size_t i_threshold);
+    //! write screening checkpoint. the file is replaced atomically,
+    //! i.e. an interrupted write keeps the previous checkpoint intact.
+    void
+    write_screening_checkpoint(const std::string filename
+                             , const ScreeningCheckpoint& checkpoint);
+    //! read screening checkpoint
+    ScreeningCheckpoint
+    read_screening_checkpoint(const std::string filename);
+    //! prepare connected components screening, without any admitted frames
+    //! or with the frames and components of the clusters of a lower threshold
+    //! (as given by a previous screening), e.g. to resume from a checkpoint.
+    //! frames of equal free energy are handled in original frame order
+    //! ('original_ids', see tie_id).
+    ScreeningComponents
+    screening_components(const std::vector<float>& free_energy
+                       , const Neighborhood& nh
+                       , const float* coords
+                       , const std::size_t n_rows
+                       , const std::size_t n_cols
+                       , const NeighborGraph::Graph* graph = nullptr
+                       , const std::vector<std::size_t>& initial_clustering = {}
+                       , const std::vector<std::size_t>& original_ids = {});
+    //! admit all frames below the (increased) threshold and link them to their
+    //! neighbors in parallel. returns the clustered trajectory, with clusters
+    //! named in order of their lowest free energy. the result is the same
+    //! as of \link Clustering::Density::screening without initial clusters,
+    //! independently of the number of threads.
+    std::vector<std::size_t>
+    screening_components_step(ScreeningComponents& components
+                            , const float free_energy_threshold
+                            , const float* coords
+                            , const std::size_t n_cols);
+    //! lump clusters based on distance threshold in screening process.
+    //! merges are recorded in 'forest', i.e. frames outside of
+    //! 'local_nh' keep their names.
+    //! 'cluster_names' is a buffer, reused over all calls.
     bool
-    lump_initial_clusters(const std::set<std::size_t>& local_nh
+    lump_initial_clusters(const std::vector<std::size_t>& local_nh
                         , std::size_t& distinct_name
                         , std::vector<std::size_t>& clustering
                         , const std::vector<FreeEnergy>& fe_sorted
-                        , std::size_t first_frame_above_threshold);
-    //! compute local neighborhood of a given frame.
-    //! neighbor candidates are all frames below a given limit,
+                        , ClusterForest& forest
+                        , std::vector<std::size_t>& cluster_names);
+    //! empty index for neighborhood queries of the screening with
+    //! squared distance criterion 'max_dist'.
+    //! all memory is allocated upfront, admitting frames and
+    //! queries do not allocate.
+    //! if given, the neighbor graph is used instead of the box grid,
+    //! as long as its cutoff covers the distance criterion.
+    ScreeningIndex
+    screening_index(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<FreeEnergy>& sorted_fe,
+                    const float max_dist,
+                    const NeighborGraph::Graph* graph = nullptr);
+    //! admit all frames below 'limit' (in order of sorted free energies) to the index.
+    void
+    admit_frames(ScreeningIndex& index,
+                 const std::vector<FreeEnergy>& sorted_fe,
+                 const std::size_t limit);
+    //! compute local neighborhood of a given frame, i.e. the frame itself and
+    //! all admitted frames closer than the distance criterion of the index
+    //! (as indices of sorted free energies).
+    //! neighbor candidates are the admitted frames of neighboring boxes,
     //! effectively limiting the frames to the ones below a free energy cutoff.
-    std::set<std::size_t>
-    high_density_neighborhood(const float* coords,
+    //! the result is kept in the query buffer until the next query.
+    const std::vector<std::size_t>&
+    high_density_neighborhood(const ScreeningIndex& index,
+                              ScreeningQuery& query,
+                              const float* coords,
                               const std::size_t n_cols,
                               const std::vector<FreeEnergy>& sorted_fe,
-                              const std::size_t i_frame,
-                              const std::size_t limit,
-                              const float max_dist);
+                              const std::size_t i_frame);
     //! compute sigma2 as deviation of squared nearest-neighbor distances.
     //! sigma2 is given by E[x^2] > Var(x) = E[x^2] - E[x]^2,
     //! with x being the distances between nearest neighbors).
@@ -176,10 +469,15 @@ namespace Clustering {
     //! then assigning the next lowest, etc.
     //! thus, all initial clusters will be filled with growing free energy, effectively producing
     //! microstates separated close to the free energy barriers.
+    //! the assignment is computed in parallel by pointer jumping along
+    //! the neighbors with higher density, with the same result.
+    //! frames of equal free energy are assigned in original frame order
+    //! ('original_ids', see tie_id).
     std::vector<std::size_t>
     assign_low_density_frames(const std::vector<std::size_t>& initial_clustering,
                               const Neighborhood& nh_high_dens,
-                              const std::vector<float>& free_energy);
+                              const std::vector<float>& free_energy,
+                              const std::vector<std::size_t>& original_ids = {});
     //! user interface and controlling function for density-based geometric clustering.\n\n
     //! *parsed parameters*:\n
     //!   - **file** : input file with coordinates\n
@@ -189,9 +487,29 @@ namespace Clustering {
     //!   - **output**: clustered trajectory\n
     //!   - **radii**: list of radii for free energy / population computations (input)\n
     //!   - **radius**: radius for clustering (input)\n
+    //!   - **population-engine**: engine for population computations ('boxes', 'kdtree', 'profile', 'gemm' or 'lsh')\n
+    //!   - **nn-engine**: engine for nearest neighbor computations ('kdtree', 'incremental', 'gemm', 'hnsw' or 'brute')\n
+    //!   - **box-dims**: number of dimensions used for the box grid of the 'boxes' and 'profile' engines\n
+    //!   - **reorder**: space-filling curve to reorder frames before computations ('none', 'morton' or 'hilbert')\n
+    //!   - **reorder-dims**: number of leading dimensions spanned by the space-filling curve\n
+    //!   - **prefilter**: decide most frame pairs on 8-bit compressed coordinates\n
+    //!   - **pivots**: number of pivot frames for triangle-inequality pruning\n
+    //!   - **partial-distances**: early abandonment of distances on variance-ordered columns\n
+    //!   - **lsh-tables**, **lsh-hashes**, **lsh-width**, **lsh-samples**: parameters of the 'lsh' engine\n
+    //!   - **hnsw-links**, **hnsw-ef-construction**, **hnsw-ef**, **hnsw-samples**: parameters of the 'hnsw' engine\n
+    //!   - **tile-checkpoint**: basename of tile checkpoints of population and nearest neighbor computations (output)\n
+    //!   - **tile-size**: number of frames per checkpoint tile\n
+    //!   - **tile-resume**: resume population and nearest neighbor computations from tile checkpoints (bool flag)\n
     //!   - **nearest-neighbors-input**: previously computed nearest neighbor list (input)\n
     //!   - **nearest-neighbors**: nearest neighbor list (output)\n
+    //!   - **neighbor-graph-input**: previously computed neighbor graph (input)\n
+    //!   - **neighbor-graph**: neighbor graph, shared by populations, nearest neighbors and screening (output)\n
+    //!   - **neighbor-graph-cutoff**: cutoff radius of the neighbor graph\n
     //!   - **threshold-screening**: option for automated free energy threshold screening (input)\n
+    //!   - **screening-engine**: engine for threshold screening without initial clusters ('sweep' or 'components')\n
+    //!   - **screening-checkpoint**: state of threshold screening for resuming interrupted runs (output)\n
+    //!   - **screening-checkpoint-interval**: number of thresholds between checkpoints\n
+    //!   - **screening-resume**: resume threshold screening from checkpoint, if it exists (bool flag)\n
     //!   - **threshold**: threshold for single run with limited free energy (input)\n
     //!   - **only-initial**: if true, do not fill microstates up to barriers,
     //!                       but keep initial clusters below free energy cutoff (bool flag)
@@ -45,6 +45,7 @@ namespace Density {
           , const int mpi_n_nodes
           , const int mpi_node_id
 #endif
+          , const std::vector<std::size_t>& original_ids
                             ) {
 #ifdef DC_USE_MPI
     using namespace Clustering::Density::MPI;
@@ -53,7 +54,7 @@ namespace Density {
     std::size_t first_frame_above_threshold;
     double sigma2;
     std::vector<FreeEnergy> fe_sorted;
-    std::set<std::size_t> visited_frames;
+    std::vector<bool> visited_frames;
     std::size_t distinct_name;
     // data preparation
     std::tie(clustering
@@ -65,7 +66,19 @@ namespace Density {
                                                        , nh
                                                        , free_energy_threshold
                                                        , n_rows
-                                                       , initial_clusters);
+                                                       , initial_clusters
+                                                       , original_ids);
+    // merged clusters, materialized in the final cluster names
+    ClusterForest forest = cluster_forest(distinct_name);
+#ifndef DC_USE_MPI
+    // all frames below the threshold are neighbor candidates
+    ScreeningIndex index = screening_index(coords, n_rows, n_cols, fe_sorted, 4*sigma2);
+    admit_frames(index, fe_sorted, first_frame_above_threshold);
+    ScreeningQuery query;
+#else
+    std::vector<std::size_t> local_nh;
+#endif
+    std::vector<std::size_t> cluster_names;
 #ifdef DC_USE_MPI
     if (mpi_node_id == MAIN_PROCESS) {
 #endif
@@ -90,41 +103,42 @@ namespace Density {
       }
 #endif
       for (std::size_t i=0; i < first_frame_above_threshold; ++i) {
-        if (visited_frames.count(i) == 0) {
-          visited_frames.insert(i);
+        if ( ! visited_frames[i]) {
+          visited_frames[i] = true;
           // all frames/clusters in local neighborhood should be merged ...
 #ifdef DC_USE_MPI
           using hdn_mpi = Clustering::Density::MPI::high_density_neighborhood;
-          std::set<std::size_t> local_nh = hdn_mpi(coords,
-                                                   n_cols,
-                                                   fe_sorted,
-                                                   i,
-                                                   first_frame_above_threshold,
-                                                   4*sigma2,
-                                                   mpi_n_nodes,
-                                                   mpi_node_id);
+          std::set<std::size_t> nh_mpi = hdn_mpi(coords,
+                                                 n_cols,
+                                                 fe_sorted,
+                                                 i,
+                                                 first_frame_above_threshold,
+                                                 4*sigma2,
+                                                 mpi_n_nodes,
+                                                 mpi_node_id);
+          local_nh.assign(nh_mpi.begin(), nh_mpi.end());
 #else
-          //TODO use box-assisted search on
-          //     fe_sorted coords for 'high_density_neighborhood'
-          std::set<std::size_t> local_nh = high_density_neighborhood(coords,
-                                                                     n_cols,
-                                                                     fe_sorted,
-                                                                     i,
-                                                                     first_frame_above_threshold,
-                                                                     4*sigma2);
+          const std::vector<std::size_t>& local_nh = high_density_neighborhood(index,
+                                                                               query,
+                                                                               coords,
+                                                                               n_cols,
+                                                                               fe_sorted,
+                                                                               i);
 #endif
           neighboring_clusters_merged = lump_initial_clusters(local_nh
                                                             , distinct_name
                                                             , clustering
                                                             , fe_sorted
-                                                            , first_frame_above_threshold)
+                                                            , forest
+                                                            , cluster_names)
                                      && neighboring_clusters_merged;
         }
       } // end for
     } // end while
     return normalized_cluster_names(first_frame_above_threshold
                                   , clustering
-                                  , fe_sorted);
+                                  , fe_sorted
+                                  , forest);
   }
 
 } // end namespace Density
@@ -41,6 +41,8 @@ namespace Density {
     //! returns state trajectory for clusters given by a free energy threshold.
     //! frames with a local free energy estimate higher than the given threshold
     //! will not be clustered and remain in 'state 0'.
+    //! frames of equal free energy are handled in original frame order
+    //! ('original_ids', see tie_id).
     std::vector<std::size_t>
     screening(const std::vector<float>& free_energy
             , const Neighborhood& nh
@@ -53,6 +55,7 @@ namespace Density {
             , const int mpi_n_nodes
             , const int mpi_node_id
 #endif
+            , const std::vector<std::size_t>& original_ids = {}
                                );
 }} // end namespace Clustering::Density
 
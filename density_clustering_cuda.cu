@@ -253,26 +253,26 @@ namespace CUDA {
     }
     cudaDeviceSynchronize();
     check_error("after kernel loop");
-    // initialize neighborhoods (on host)
-    Neighborhood nh;
-    Neighborhood nhhd;
-    // collect results from GPU
-    std::vector<unsigned int> buf_ndx(n_rows * 2);
-    std::vector<float> buf_dist(n_rows * 2);
-    cudaMemcpy(buf_ndx.data()
+    // collect results from GPU directly into neighbor tables
+    // (device buffers hold NN in first, NN with higher density in second half)
+    Neighborhood nh(n_rows, 0, 0.0f);
+    Neighborhood nhhd(n_rows, 0, 0.0f);
+    cudaMemcpy(nh.ids.data()
              , d_nh_nhhd_ndx
-             , sizeof(unsigned int) * n_rows * 2
+             , sizeof(unsigned int) * n_rows
              , cudaMemcpyDeviceToHost);
-    cudaMemcpy(buf_dist.data()
+    cudaMemcpy(nhhd.ids.data()
+             , d_nh_nhhd_ndx + n_rows
+             , sizeof(unsigned int) * n_rows
+             , cudaMemcpyDeviceToHost);
+    cudaMemcpy(nh.dist2.data()
              , d_nh_nhhd_dist
-             , sizeof(float) * n_rows * 2
+             , sizeof(float) * n_rows
+             , cudaMemcpyDeviceToHost);
+    cudaMemcpy(nhhd.dist2.data()
+             , d_nh_nhhd_dist + n_rows
+             , sizeof(float) * n_rows
              , cudaMemcpyDeviceToHost);
-    for (unsigned int i=0; i < n_rows; ++i) {
-      nh[i] = {buf_ndx[i]
-             , buf_dist[i]};
-      nhhd[i] = {buf_ndx[n_rows+i]
-               , buf_dist[n_rows+i]};
-    }
     // device cleanup
     cudaFree(d_coords);
     cudaFree(d_fe);
@@ -312,14 +312,13 @@ namespace CUDA {
     Neighborhood nhhd;
     std::tie(nh, nhhd) = partials[0];
     for (i_gpu=1; i_gpu < n_gpus; ++i_gpu) {
-      Neighborhood partial_nh;
-      Neighborhood partial_nhhd;
-      std::tie(partial_nh, partial_nhhd) = partials[i_gpu];
+      const Neighborhood& partial_nh = std::get<0>(partials[i_gpu]);
+      const Neighborhood& partial_nhhd = std::get<1>(partials[i_gpu]);
       for (unsigned int i=0; i < n_rows; ++i) {
-        if ((partial_nh[i].second != 0)
-         || (partial_nhhd[i].second != 0)) {
-          nh[i] = partial_nh[i];
-          nhhd[i] = partial_nhhd[i];
+        if ((partial_nh.dist2[i] != 0)
+         || (partial_nhhd.dist2[i] != 0)) {
+          nh.set(i, partial_nh.ids[i], partial_nh.dist2[i]);
+          nhhd.set(i, partial_nhhd.ids[i], partial_nhhd.dist2[i]);
         }
       }
     }
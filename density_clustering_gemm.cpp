@@ -0,0 +1,358 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_gemm.hpp"
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace Clustering {
+namespace Density {
+namespace GEMM {
+
+  namespace {
+    /*!
+     * pack coordinate columns 'k_from' ... 'k_from+n_depth-1' of frames
+     * 'from' ... 'from+n-1' into panels of 'panel' frames, column by column,
+     * format: [(p * n_depth + k) * panel + r].
+     * the last panel is padded with zeros.
+     */
+    void
+    pack(const float* coords,
+         const std::size_t n_cols,
+         const std::size_t from,
+         const std::size_t n,
+         const std::size_t k_from,
+         const std::size_t n_depth,
+         const std::size_t panel,
+         float* packed) {
+      const std::size_t n_panels = (n + panel - 1) / panel;
+      for (std::size_t p=0; p < n_panels; ++p) {
+        for (std::size_t r=0; r < panel; ++r) {
+          const std::size_t i = p*panel + r;
+          float* dst = &packed[p*n_depth*panel + r];
+          if (i < n) {
+            const float* src = &coords[(from+i)*n_cols + k_from];
+            for (std::size_t k=0; k < n_depth; ++k) {
+              dst[k*panel] = src[k];
+            }
+          } else {
+            for (std::size_t k=0; k < n_depth; ++k) {
+              dst[k*panel] = 0.0f;
+            }
+          }
+        }
+      }
+    }
+
+    /*!
+     * dot products of a panel of MICRO_ROWS frames ('a') with a panel of
+     * MICRO_COLS frames ('b'), added to 'c' (row stride TILE_COLS).
+     * the accumulators are kept in registers, the loop over the
+     * candidates is vectorized.
+     */
+    inline void
+    micro_kernel(const float* a,
+                 const float* b,
+                 const std::size_t n_depth,
+                 float* c) {
+      float acc[MICRO_ROWS][MICRO_COLS] = {{0.0f}};
+      for (std::size_t k=0; k < n_depth; ++k) {
+        const float* a_k = &a[k*MICRO_ROWS];
+        const float* b_k = &b[k*MICRO_COLS];
+        for (std::size_t r=0; r < MICRO_ROWS; ++r) {
+          for (std::size_t s=0; s < MICRO_COLS; ++s) {
+            acc[r][s] += a_k[r] * b_k[s];
+          }
+        }
+      }
+      for (std::size_t r=0; r < MICRO_ROWS; ++r) {
+        for (std::size_t s=0; s < MICRO_COLS; ++s) {
+          c[r*TILE_COLS+s] += acc[r][s];
+        }
+      }
+    }
+
+    void
+    log_tile_stats(const std::size_t n_candidates,
+                   const std::size_t n_exact) {
+      Clustering::logger(std::cout) << " tiled distances decided "
+                                    << (n_candidates == 0 ? 0.0
+                                                          : 100.0 * (n_candidates - n_exact) / n_candidates)
+                                    << "% of " << n_candidates << " candidate pairs"
+                                    << std::endl;
+    }
+  } // end local namespace
+
+  CenteredCoords
+  centered_coords(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols) {
+    CenteredCoords cc;
+    cc.n_rows = n_rows;
+    cc.n_cols = n_cols;
+    // errors of dot products and norms grow linearly with the number of
+    // summed up dimensions and are relative to the squared norms.
+    // this bound also covers the rounding errors of the centering and
+    // of the exact distances of the SIMD kernels.
+    cc.tolerance = 8.0f * (n_cols + 4) * std::numeric_limits<float>::epsilon();
+    std::vector<double> mean(n_cols, 0.0);
+    for (std::size_t i=0; i < n_rows; ++i) {
+      for (std::size_t k=0; k < n_cols; ++k) {
+        mean[k] += coords[i*n_cols+k];
+      }
+    }
+    for (std::size_t k=0; k < n_cols; ++k) {
+      mean[k] /= std::max<std::size_t>(1, n_rows);
+    }
+    cc.coords.resize(n_rows*n_cols);
+    cc.norm2.resize(n_rows);
+    for (std::size_t i=0; i < n_rows; ++i) {
+      float norm2 = 0.0f;
+      for (std::size_t k=0; k < n_cols; ++k) {
+        float x = coords[i*n_cols+k] - (float) mean[k];
+        cc.coords[i*n_cols+k] = x;
+        norm2 += x*x;
+      }
+      cc.norm2[i] = norm2;
+    }
+    return cc;
+  }
+
+  void
+  distance_tile(const CenteredCoords& cc,
+                const std::size_t i_from,
+                const std::size_t n_i,
+                const std::size_t j_from,
+                const std::size_t n_j,
+                std::vector<float>& buf,
+                float* dist2) {
+    const std::size_t n_cols = cc.n_cols;
+    const std::size_t n_panels_i = (n_i + MICRO_ROWS - 1) / MICRO_ROWS;
+    const std::size_t n_panels_j = (n_j + MICRO_COLS - 1) / MICRO_COLS;
+    buf.resize((TILE_ROWS + TILE_COLS) * TILE_DEPTH);
+    float* a = buf.data();
+    float* b = &buf[TILE_ROWS*TILE_DEPTH];
+    std::fill(dist2, dist2 + n_panels_i*MICRO_ROWS*TILE_COLS, 0.0f);
+    // dot products, blocked over the columns such that the packed
+    // coordinates of both blocks stay in cache
+    for (std::size_t k_from=0; k_from < n_cols; k_from += TILE_DEPTH) {
+      const std::size_t n_depth = std::min(TILE_DEPTH, n_cols-k_from);
+      pack(cc.coords.data(), n_cols, i_from, n_i, k_from, n_depth, MICRO_ROWS, a);
+      pack(cc.coords.data(), n_cols, j_from, n_j, k_from, n_depth, MICRO_COLS, b);
+      for (std::size_t pi=0; pi < n_panels_i; ++pi) {
+        for (std::size_t pj=0; pj < n_panels_j; ++pj) {
+          micro_kernel(&a[pi*n_depth*MICRO_ROWS]
+                     , &b[pj*n_depth*MICRO_COLS]
+                     , n_depth
+                     , &dist2[pi*MICRO_ROWS*TILE_COLS + pj*MICRO_COLS]);
+        }
+      }
+    }
+    for (std::size_t i=0; i < n_i; ++i) {
+      const float norm2_i = cc.norm2[i_from+i];
+      float* d = &dist2[i*TILE_COLS];
+      for (std::size_t j=0; j < n_j; ++j) {
+        d[j] = norm2_i + cc.norm2[j_from+j] - 2.0f*d[j];
+      }
+    }
+  }
+
+  Pops
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        std::vector<float> radii) {
+    std::sort(radii.begin(), radii.end(), std::greater<float>());
+    std::size_t n_radii = radii.size();
+    std::vector<float> rad2(n_radii);
+    for (std::size_t l=0; l < n_radii; ++l) {
+      rad2[l] = radii[l]*radii[l];
+    }
+    const CenteredCoords cc = centered_coords(coords, n_rows, n_cols);
+    Clustering::logger(std::cout) << "computing pops with tiled distances" << std::endl;
+    // pops per radius index; every frame is only written by the
+    // thread that handles its tile, so no synchronization is needed.
+    std::vector<std::vector<std::size_t>> pops_buf(n_radii
+                                                 , std::vector<std::size_t>(n_rows));
+    const std::size_t n_tiles = (n_rows + TILE_ROWS - 1) / TILE_ROWS;
+    const float tol = cc.tolerance;
+    std::size_t i_tile, i_from, n_i, j_from, n_j, i, j, l;
+    std::size_t n_candidates = 0;
+    std::size_t n_exact = 0;
+    float d2, err, exact_d2;
+    bool have_exact;
+    std::vector<float> buf;
+    std::vector<float> dist2(TILE_ROWS*TILE_COLS);
+    std::vector<std::size_t> counts;
+    #pragma omp parallel for default(none)\
+      private(i_tile,i_from,n_i,j_from,n_j,i,j,l,d2,err,exact_d2,have_exact)\
+      firstprivate(n_rows,n_cols,n_radii,n_tiles,tol,buf,dist2,counts)\
+      shared(coords,cc,rad2,pops_buf)\
+      reduction(+:n_candidates,n_exact)\
+      schedule(dynamic,1)
+    for (i_tile=0; i_tile < n_tiles; ++i_tile) {
+      i_from = i_tile*TILE_ROWS;
+      n_i = std::min(n_rows-i_from, (std::size_t) TILE_ROWS);
+      // every frame counts itself
+      counts.assign(n_i*n_radii, 1);
+      for (j_from=0; j_from < n_rows; j_from += TILE_COLS) {
+        n_j = std::min(n_rows-j_from, (std::size_t) TILE_COLS);
+        distance_tile(cc, i_from, n_i, j_from, n_j, buf, dist2.data());
+        n_candidates += n_i*n_j;
+        for (i=0; i < n_i; ++i) {
+          for (j=0; j < n_j; ++j) {
+            if (i_from+i == j_from+j) {
+              continue;
+            }
+            d2 = dist2[i*TILE_COLS+j];
+            err = tol * (cc.norm2[i_from+i] + cc.norm2[j_from+j]);
+            // most candidates are outside of the largest radius
+            if (d2 - err >= rad2[0]) {
+              continue;
+            }
+            have_exact = false;
+            for (l=0; l < n_radii; ++l) {
+              if (d2 + err < rad2[l]) {
+                ++counts[i*n_radii+l];
+                continue;
+              }
+              if (d2 - err >= rad2[l]) {
+                break;
+              }
+              // borderline pair: decide on exact distance
+              if ( ! have_exact) {
+                exact_d2 = SIMD::squared_distance(&coords[(i_from+i)*n_cols]
+                                                , &coords[(j_from+j)*n_cols]
+                                                , n_cols);
+                have_exact = true;
+                ++n_exact;
+              }
+              if (exact_d2 < rad2[l]) {
+                ++counts[i*n_radii+l];
+              } else {
+                // if it's not in the bigger radius,
+                // it won't be in the smaller ones.
+                break;
+              }
+            }
+          }
+        }
+      }
+      for (i=0; i < n_i; ++i) {
+        for (l=0; l < n_radii; ++l) {
+          pops_buf[l][i_from+i] = counts[i*n_radii+l];
+        }
+      }
+    }
+    log_tile_stats(n_candidates, n_exact);
+    Pops pops;
+    for (l=0; l < n_radii; ++l) {
+      pops[radii[l]] = std::move(pops_buf[l]);
+    }
+    return pops;
+  }
+
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const std::vector<std::size_t>& original_ids) {
+    const CenteredCoords cc = centered_coords(coords, n_rows, n_cols);
+    Clustering::logger(std::cout) << "computing nearest neighbors with tiled distances" << std::endl;
+    Neighborhood nh(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    Neighborhood nh_high_dens(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    const std::size_t n_tiles = (n_rows + TILE_ROWS - 1) / TILE_ROWS;
+    const float tol = cc.tolerance;
+    std::size_t i_tile, i_from, n_i, j_from, n_j, i, j, id_i, id_j;
+    std::size_t n_candidates = 0;
+    std::size_t n_exact = 0;
+    float lower, exact_d2;
+    bool high_dens;
+    std::vector<float> buf;
+    std::vector<float> dist2(TILE_ROWS*TILE_COLS);
+    #pragma omp parallel for default(none)\
+      private(i_tile,i_from,n_i,j_from,n_j,i,j,id_i,id_j,lower,exact_d2,high_dens)\
+      firstprivate(n_rows,n_cols,n_tiles,tol,buf,dist2)\
+      shared(coords,cc,free_energy,original_ids,nh,nh_high_dens)\
+      reduction(+:n_candidates,n_exact)\
+      schedule(dynamic,1)
+    for (i_tile=0; i_tile < n_tiles; ++i_tile) {
+      i_from = i_tile*TILE_ROWS;
+      n_i = std::min(n_rows-i_from, (std::size_t) TILE_ROWS);
+      // candidates in ascending order, as in exhaustive search
+      for (j_from=0; j_from < n_rows; j_from += TILE_COLS) {
+        n_j = std::min(n_rows-j_from, (std::size_t) TILE_COLS);
+        distance_tile(cc, i_from, n_i, j_from, n_j, buf, dist2.data());
+        n_candidates += n_i*n_j;
+        for (i=0; i < n_i; ++i) {
+          id_i = i_from+i;
+          for (j=0; j < n_j; ++j) {
+            id_j = j_from+j;
+            if (id_i == id_j) {
+              continue;
+            }
+            // skip frames that definitely are farther away
+            // than the current neighbors
+            lower = dist2[i*TILE_COLS+j] - tol * (cc.norm2[id_i] + cc.norm2[id_j]);
+            high_dens = (free_energy[id_j] < free_energy[id_i]);
+            if (lower > nh.dist2[id_i]
+             && ( ! high_dens || lower > nh_high_dens.dist2[id_i])) {
+              continue;
+            }
+            exact_d2 = SIMD::squared_distance(&coords[id_i*n_cols]
+                                            , &coords[id_j*n_cols]
+                                            , n_cols);
+            ++n_exact;
+            // direct neighbor
+            if (exact_d2 < nh.dist2[id_i]
+             || (exact_d2 == nh.dist2[id_i]
+              && nh.ids[id_i] < n_rows
+              && tie_id(original_ids, id_j) < tie_id(original_ids, nh.ids[id_i]))) {
+              nh.set(id_i, id_j, exact_d2);
+            }
+            // next neighbor with higher density / lower free energy
+            if (high_dens
+             && (exact_d2 < nh_high_dens.dist2[id_i]
+              || (exact_d2 == nh_high_dens.dist2[id_i]
+               && nh_high_dens.ids[id_i] < n_rows
+               && tie_id(original_ids, id_j) < tie_id(original_ids, nh_high_dens.ids[id_i])))) {
+              nh_high_dens.set(id_i, id_j, exact_d2);
+            }
+          }
+        }
+      }
+    }
+    log_tile_stats(n_candidates, n_exact);
+    return std::make_tuple(nh, nh_high_dens);
+  }
+
+} // end namespace GEMM
+} // end namespace Density
+} // end namespace Clustering
+
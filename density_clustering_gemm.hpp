@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+#include "density_clustering_common.hpp"
+
+#include <vector>
+#include <map>
+#include <tuple>
+
+/*! \file
+ * tiled distance engine for high-dimensional data.
+ *
+ * squared distances of blocks of frames are computed as
+ *
+ *   |x-y|^2 = |x|^2 + |y|^2 - 2 x*y,
+ *
+ * with the dot products of a tile given by a matrix product of the
+ * coordinate blocks. the product is computed by a cache-blocked
+ * micro-kernel on packed coordinates, running close to peak FLOPs
+ * for data with many columns.
+ *
+ * the expansion suffers from cancellation, thus every distance of a tile
+ * is only an approximation with a known error bound. pairs that cannot be
+ * decided on the approximate distance (i.e. are within the error bound of
+ * a radius or of the current nearest neighbor) are re-evaluated with the
+ * kernels of Clustering::Density::SIMD. results are exactly the same as
+ * for the other engines.
+ */
+
+namespace Clustering {
+namespace Density {
+//! tiled distance engine based on matrix products
+namespace GEMM {
+  //! rows (reference frames) of the micro-kernel
+  const std::size_t MICRO_ROWS = 4;
+  //! columns (neighbor candidates) of the micro-kernel
+  const std::size_t MICRO_COLS = 8;
+  //! reference frames per tile (multiple of MICRO_ROWS)
+  const std::size_t TILE_ROWS = 64;
+  //! neighbor candidates per tile (multiple of MICRO_COLS)
+  const std::size_t TILE_COLS = 256;
+  //! coordinate columns per cache block of the matrix product
+  const std::size_t TILE_DEPTH = 128;
+  //! coordinates centered on their mean (for smaller norms, i.e.
+  //! smaller errors of the expansion) with squared norms per frame.
+  struct CenteredCoords {
+    std::size_t n_rows;
+    std::size_t n_cols;
+    //! centered coordinates, format: [row * n_cols + col]
+    std::vector<float> coords;
+    //! squared norms of centered frames
+    std::vector<float> norm2;
+    //! error bound of approximate squared distances
+    //! relative to the sum of squared norms of both frames
+    float tolerance;
+  };
+  //! center coordinates and compute squared norms
+  CenteredCoords
+  centered_coords(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols);
+  //! approximate squared distances of frames 'i_from' ... 'i_from+n_i-1'
+  //! to frames 'j_from' ... 'j_from+n_j-1' (with n_i <= TILE_ROWS and
+  //! n_j <= TILE_COLS), written to 'dist2' in format [i * TILE_COLS + j].
+  //! 'buf' is used as buffer for packed coordinates.
+  void
+  distance_tile(const CenteredCoords& cc,
+                const std::size_t i_from,
+                const std::size_t n_i,
+                const std::size_t j_from,
+                const std::size_t n_j,
+                std::vector<float>& buf,
+                float* dist2);
+  //! tiled implementation of
+  //! \link Clustering::Density::calculate_populations(const float* coords, const std::size_t n_rows, const std::size_t n_cols, const std::vector<float> radii)
+  //! results are exactly the same as for the box-assisted search.
+  Pops
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        std::vector<float> radii);
+  //! tiled implementation of
+  //! \link Clustering::Density::nearest_neighbors
+  //! results are exactly the same as for the brute-force search.
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const std::vector<std::size_t>& original_ids = {});
+} // end namespace GEMM
+} // end namespace Density
+} // end namespace Clustering
+
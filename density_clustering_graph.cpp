@@ -0,0 +1,432 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_graph.hpp"
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+
+namespace Clustering {
+namespace Density {
+namespace NeighborGraph {
+
+  namespace {
+    //! identifier of graph files (and format version)
+    const char FILE_MAGIC[8] = {'D', 'C', 'N', 'B', 'G', 'R', 'P', '2'};
+
+    //! graph with frames renumbered: frame i becomes new_id[i]
+    Graph
+    renumbered(const Graph& graph,
+               const std::vector<std::size_t>& new_id) {
+      const std::size_t n_rows = graph.n_rows;
+      std::vector<std::size_t> old_id(n_rows);
+      for (std::size_t i=0; i < n_rows; ++i) {
+        old_id[new_id[i]] = i;
+      }
+      Graph g;
+      g.n_rows = n_rows;
+      g.cutoff = graph.cutoff;
+      g.offsets.resize(n_rows+1);
+      g.offsets[0] = 0;
+      for (std::size_t i=0; i < n_rows; ++i) {
+        std::size_t o = old_id[i];
+        g.offsets[i+1] = g.offsets[i] + (graph.offsets[o+1] - graph.offsets[o]);
+      }
+      g.ids.resize(graph.ids.size());
+      g.dist2.resize(graph.dist2.size());
+      std::size_t i;
+      std::vector<std::pair<uint32_t, float>> neighbors;
+      #pragma omp parallel for default(none)\
+        private(i)\
+        firstprivate(n_rows,neighbors)\
+        shared(graph,g,old_id,new_id)\
+        schedule(dynamic,1024)
+      for (i=0; i < n_rows; ++i) {
+        std::size_t o = old_id[i];
+        neighbors.clear();
+        for (std::size_t k=graph.offsets[o]; k < graph.offsets[o+1]; ++k) {
+          neighbors.emplace_back((uint32_t) new_id[graph.ids[k]], graph.dist2[k]);
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        for (std::size_t k=0; k < neighbors.size(); ++k) {
+          g.ids[g.offsets[i]+k] = neighbors[k].first;
+          g.dist2[g.offsets[i]+k] = neighbors[k].second;
+        }
+      }
+      return g;
+    }
+
+    //! is 'dist2' of frame 'j' closer than the current neighbor?
+    //! ties are broken by lowest (original) frame id.
+    bool
+    is_closer(const float dist2,
+              const std::size_t j,
+              const float mindist,
+              const std::size_t min_j,
+              const std::size_t n_rows,
+              const std::vector<std::size_t>& original_ids) {
+      return dist2 < mindist
+          || (dist2 == mindist
+           && min_j < n_rows
+           && tie_id(original_ids, j) < tie_id(original_ids, min_j));
+    }
+
+    //! exhaustive search for the nearest neighbor (with lower free energy)
+    //! of frame i, frames in ascending order.
+    void
+    exhaustive_search(const float* coords,
+                      const std::size_t n_rows,
+                      const std::size_t n_cols,
+                      const std::vector<float>& free_energy,
+                      const std::vector<std::size_t>& original_ids,
+                      const std::size_t i,
+                      const bool high_dens_only,
+                      std::vector<float>& dist2,
+                      std::size_t& min_j,
+                      float& mindist) {
+      const std::size_t chunk_size = dist2.size();
+      for (std::size_t j_from=0; j_from < n_rows; j_from += chunk_size) {
+        std::size_t n_chunk = std::min(chunk_size, n_rows-j_from);
+        SIMD::squared_distances(&coords[i*n_cols]
+                              , &coords[j_from*n_cols]
+                              , n_chunk
+                              , n_cols
+                              , dist2.data());
+        for (std::size_t q=0; q < n_chunk; ++q) {
+          std::size_t j = j_from+q;
+          if (j != i
+           && ( ! high_dens_only || free_energy[j] < free_energy[i])
+           && is_closer(dist2[q], j, mindist, min_j, n_rows, original_ids)) {
+            mindist = dist2[q];
+            min_j = j;
+          }
+        }
+      }
+    }
+  } // end local namespace
+
+  Graph
+  build_graph(const float* coords,
+              const std::size_t n_rows,
+              const std::size_t n_cols,
+              const float cutoff,
+              const std::size_t n_box_dims) {
+    if ( ! (cutoff > 0.0f)) {
+      std::cerr << "error: neighbor graph needs a positive cutoff." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    Graph g;
+    g.n_rows = n_rows;
+    g.cutoff = cutoff;
+    g.offsets.assign(n_rows+1, 0);
+    const float cutoff2 = cutoff*cutoff;
+    // boxes are slightly wider than the cutoff, such that
+    // rounding of box coordinates does not lose neighbors.
+    const BoxGrid grid = compute_box_grid(coords, n_rows, n_cols, cutoff*1.001f, n_box_dims);
+    // neighbors are collected for blocks of frames in parallel
+    // and appended to the graph in order of frames.
+    const std::size_t block_size = 4096;
+    std::vector<std::vector<std::pair<uint32_t, float>>> block_neighbors(block_size);
+    std::size_t b, i, i_from, n_block;
+    std::vector<std::size_t> boxes;
+    std::vector<std::size_t> candidates;
+    std::vector<float> dist2;
+    for (i_from=0; i_from < n_rows; i_from += block_size) {
+      n_block = std::min(block_size, n_rows-i_from);
+      #pragma omp parallel for default(none)\
+        private(b,i)\
+        firstprivate(i_from,n_block,n_cols,cutoff2,boxes,candidates,dist2)\
+        shared(coords,grid,block_neighbors)\
+        schedule(dynamic,16)
+      for (b=0; b < n_block; ++b) {
+        i = i_from+b;
+        neighbor_boxes(grid, grid.assigned_box[i], boxes);
+        candidates.clear();
+        for (std::size_t i_box: boxes) {
+          candidates.insert(candidates.end()
+                          , grid.frames.begin() + grid.box_offsets[i_box]
+                          , grid.frames.begin() + grid.box_offsets[i_box+1]);
+        }
+        dist2.resize(candidates.size());
+        SIMD::squared_distances(&coords[i*n_cols]
+                              , coords
+                              , candidates.data()
+                              , candidates.size()
+                              , n_cols
+                              , dist2.data());
+        std::vector<std::pair<uint32_t, float>>& neighbors = block_neighbors[b];
+        neighbors.clear();
+        for (std::size_t q=0; q < candidates.size(); ++q) {
+          if (candidates[q] != i && dist2[q] < cutoff2) {
+            neighbors.emplace_back((uint32_t) candidates[q], dist2[q]);
+          }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+      }
+      for (b=0; b < n_block; ++b) {
+        for (const std::pair<uint32_t, float>& neighbor: block_neighbors[b]) {
+          g.ids.push_back(neighbor.first);
+          g.dist2.push_back(neighbor.second);
+        }
+        g.offsets[i_from+b+1] = g.ids.size();
+      }
+    }
+    Clustering::logger(std::cout) << " neighbor graph: " << g.ids.size() << " links, "
+                                  << (n_rows > 0 ? (double) g.ids.size() / n_rows : 0.0)
+                                  << " per frame" << std::endl;
+    return g;
+  }
+
+  std::map<float, std::vector<std::size_t>>
+  calculate_populations(const Graph& graph,
+                        std::vector<float> radii) {
+    std::sort(radii.begin(), radii.end(), std::greater<float>());
+    if (radii.size() > 0 && radii[0] > graph.cutoff) {
+      std::cerr << "error: radius " << radii[0] << " is larger than the cutoff "
+                << graph.cutoff << " of the neighbor graph." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    const std::size_t n_rows = graph.n_rows;
+    const std::size_t n_radii = radii.size();
+    std::vector<float> rad2(n_radii);
+    for (std::size_t l=0; l < n_radii; ++l) {
+      rad2[l] = radii[l]*radii[l];
+    }
+    // format: [frame * n_radii + l]
+    std::vector<std::size_t> counts(n_rows*n_radii, 0);
+    std::size_t i, k, l;
+    #pragma omp parallel for default(none)\
+      private(i,k,l)\
+      firstprivate(n_rows,n_radii,rad2)\
+      shared(graph,counts)\
+      schedule(dynamic,1024)
+    for (i=0; i < n_rows; ++i) {
+      for (k=graph.offsets[i]; k < graph.offsets[i+1]; ++k) {
+        for (l=0; l < n_radii; ++l) {
+          if (graph.dist2[k] < rad2[l]) {
+            ++counts[i*n_radii+l];
+          } else {
+            // if it's not in the bigger radius,
+            // it won't be in the smaller ones.
+            break;
+          }
+        }
+      }
+    }
+    std::map<float, std::vector<std::size_t>> pops;
+    for (l=0; l < n_radii; ++l) {
+      pops[radii[l]].resize(n_rows);
+      for (i=0; i < n_rows; ++i) {
+        // every frame counts itself
+        pops[radii[l]][i] = counts[i*n_radii+l] + 1;
+      }
+    }
+    return pops;
+  }
+
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const Graph& graph,
+                    const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const std::vector<std::size_t>& original_ids) {
+    Neighborhood nh(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    Neighborhood nh_high_dens(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    const std::size_t chunk_size = 1024;
+    std::size_t i, k, j, min_j, min_j_high_dens;
+    std::size_t n_exhaustive = 0;
+    float mindist, mindist_high_dens;
+    std::vector<float> dist2(chunk_size);
+    #pragma omp parallel for default(none)\
+      private(i,k,j,min_j,min_j_high_dens,mindist,mindist_high_dens)\
+      firstprivate(n_rows,n_cols,dist2)\
+      shared(graph,coords,free_energy,original_ids,nh,nh_high_dens)\
+      reduction(+:n_exhaustive)\
+      schedule(dynamic,1024)
+    for (i=0; i < n_rows; ++i) {
+      mindist = std::numeric_limits<float>::max();
+      mindist_high_dens = std::numeric_limits<float>::max();
+      min_j = n_rows+1;
+      min_j_high_dens = n_rows+1;
+      // neighbors in ascending order, as in exhaustive search
+      for (k=graph.offsets[i]; k < graph.offsets[i+1]; ++k) {
+        j = graph.ids[k];
+        if (is_closer(graph.dist2[k], j, mindist, min_j, n_rows, original_ids)) {
+          mindist = graph.dist2[k];
+          min_j = j;
+        }
+        if (free_energy[j] < free_energy[i]
+         && is_closer(graph.dist2[k], j, mindist_high_dens, min_j_high_dens, n_rows, original_ids)) {
+          mindist_high_dens = graph.dist2[k];
+          min_j_high_dens = j;
+        }
+      }
+      // all frames closer than the cutoff are in the graph,
+      // i.e. only frames without neighbors need a full search.
+      if (min_j > n_rows) {
+        ++n_exhaustive;
+        exhaustive_search(coords, n_rows, n_cols, free_energy, original_ids, i, false, dist2, min_j, mindist);
+      }
+      if (min_j_high_dens > n_rows) {
+        ++n_exhaustive;
+        exhaustive_search(coords, n_rows, n_cols, free_energy, original_ids, i, true, dist2, min_j_high_dens, mindist_high_dens);
+      }
+      nh.set(i, min_j, mindist);
+      nh_high_dens.set(i, min_j_high_dens, mindist_high_dens);
+    }
+    Clustering::logger(std::cout) << " neighbor graph: " << n_exhaustive
+                                  << " exhaustive searches for frames without neighbors in the graph"
+                                  << std::endl;
+    return std::make_tuple(nh, nh_high_dens);
+  }
+
+  Graph
+  reordered(const Graph& graph,
+            const std::vector<std::size_t>& order) {
+    if (order.empty()) {
+      return graph;
+    }
+    // new id of frame i: position[i]
+    std::vector<std::size_t> position(order.size());
+    for (std::size_t i=0; i < order.size(); ++i) {
+      position[order[i]] = i;
+    }
+    return renumbered(graph, position);
+  }
+
+  Graph
+  original_order(const Graph& graph,
+                 const std::vector<std::size_t>& order) {
+    if (order.empty()) {
+      return graph;
+    }
+    return renumbered(graph, order);
+  }
+
+  void
+  write_graph(const std::string filename,
+              const Graph& graph,
+              const uint64_t data_fingerprint) {
+    std::ofstream ofs(filename, std::ios::binary);
+    if (ofs.fail()) {
+      std::cerr << "error: cannot open file '" << filename << "' for writing." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    // format: magic, fingerprint, n_rows, n_links, cutoff, offsets, ids, squared distances
+    uint64_t n_rows = graph.n_rows;
+    uint64_t n_links = graph.ids.size();
+    std::vector<uint64_t> offsets(graph.offsets.begin(), graph.offsets.end());
+    ofs.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    ofs.write(reinterpret_cast<const char*>(&data_fingerprint), sizeof(data_fingerprint));
+    ofs.write(reinterpret_cast<const char*>(&n_rows), sizeof(n_rows));
+    ofs.write(reinterpret_cast<const char*>(&n_links), sizeof(n_links));
+    ofs.write(reinterpret_cast<const char*>(&graph.cutoff), sizeof(graph.cutoff));
+    ofs.write(reinterpret_cast<const char*>(offsets.data()), offsets.size()*sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(graph.ids.data()), n_links*sizeof(uint32_t));
+    ofs.write(reinterpret_cast<const char*>(graph.dist2.data()), n_links*sizeof(float));
+    if (ofs.fail()) {
+      std::cerr << "error: cannot write neighbor graph to '" << filename << "'." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  Graph
+  read_graph(const std::string filename,
+             const std::size_t n_rows,
+             const uint64_t data_fingerprint) {
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (ifs.fail()) {
+      std::cerr << "error: cannot open file '" << filename << "'" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    const uint64_t file_size = ifs.tellg();
+    ifs.seekg(0);
+    char magic[sizeof(FILE_MAGIC)];
+    uint64_t file_fp = 0;
+    uint64_t file_n_rows = 0;
+    uint64_t n_links = 0;
+    Graph g;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&file_fp), sizeof(file_fp));
+    ifs.read(reinterpret_cast<char*>(&file_n_rows), sizeof(file_n_rows));
+    ifs.read(reinterpret_cast<char*>(&n_links), sizeof(n_links));
+    ifs.read(reinterpret_cast<char*>(&g.cutoff), sizeof(g.cutoff));
+    if (ifs.fail() || std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+      std::cerr << "error: '" << filename << "' is not a neighbor graph file"
+                << " (or of an older format)." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (file_n_rows != n_rows) {
+      std::cerr << "error: neighbor graph has " << file_n_rows << " frames, but coordinates have "
+                << n_rows << " frames." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (file_fp != data_fingerprint) {
+      std::cerr << "error: neighbor graph '" << filename << "' was built from different data." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    // sizes are checked before allocation, the counts may be garbage
+    const uint64_t header_size = ifs.tellg();
+    const uint64_t data_size = file_size - header_size;
+    if (n_rows >= data_size / sizeof(uint64_t)
+     || n_links > data_size / (sizeof(uint32_t) + sizeof(float))
+     || (n_rows+1)*sizeof(uint64_t) + n_links*(sizeof(uint32_t) + sizeof(float)) != data_size) {
+      std::cerr << "error: neighbor graph file '" << filename << "' is truncated or corrupt." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    g.n_rows = n_rows;
+    std::vector<uint64_t> offsets(n_rows+1);
+    g.ids.resize(n_links);
+    g.dist2.resize(n_links);
+    ifs.read(reinterpret_cast<char*>(offsets.data()), offsets.size()*sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(g.ids.data()), n_links*sizeof(uint32_t));
+    ifs.read(reinterpret_cast<char*>(g.dist2.data()), n_links*sizeof(float));
+    bool consistent = ( ! ifs.fail() && offsets[0] == 0 && offsets[n_rows] == n_links);
+    for (std::size_t i=0; consistent && i < n_rows; ++i) {
+      consistent = (offsets[i] <= offsets[i+1]);
+    }
+    for (std::size_t k=0; consistent && k < n_links; ++k) {
+      consistent = (g.ids[k] < n_rows);
+    }
+    if ( ! consistent) {
+      std::cerr << "error: neighbor graph file '" << filename << "' is truncated or corrupt." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    g.offsets.assign(offsets.begin(), offsets.end());
+    return g;
+  }
+
+} // end namespace NeighborGraph
+} // end namespace Density
+} // end namespace Clustering
+
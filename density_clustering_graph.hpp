@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+#include "density_clustering_common.hpp"
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/*! \file
+ * sparse graph of all frame pairs closer than a cutoff radius.
+ *
+ * the graph is built once by box-assisted search (with exact distances)
+ * and holds the squared distances of all neighboring pairs. populations
+ * for radii up to the cutoff, nearest neighbors and the neighborhoods
+ * of the screening (if 2*sigma is below the cutoff) are derived from it
+ * without any further distance computations, with exactly the same results.
+ * the graph can be saved to disk and reused by later runs.
+ */
+
+namespace Clustering {
+namespace Density {
+//! neighbor graph shared by population, nearest neighbor and screening computations
+namespace NeighborGraph {
+  //! neighbors of all frames in compressed sparse row (CSR) format,
+  //! i.e. the neighbors of the i-th frame are ids[offsets[i]] ... ids[offsets[i+1]-1]
+  //! (in ascending order) with squared distances dist2[offsets[i]] ... .
+  struct Graph {
+    std::size_t n_rows;
+    //! all pairs with squared distance below cutoff^2 are neighbors
+    float cutoff;
+    std::vector<std::size_t> offsets;
+    std::vector<uint32_t> ids;
+    std::vector<float> dist2;
+  };
+  //! build graph with given cutoff via box grid on the first 'n_box_dims' columns
+  Graph
+  build_graph(const float* coords,
+              const std::size_t n_rows,
+              const std::size_t n_cols,
+              const float cutoff,
+              const std::size_t n_box_dims);
+  //! populations for radii up to the cutoff, as by
+  //! \link Clustering::Density::calculate_populations
+  std::map<float, std::vector<std::size_t>>
+  calculate_populations(const Graph& graph,
+                        std::vector<float> radii);
+  //! nearest neighbors, as by \link Clustering::Density::nearest_neighbors.
+  //! frames without (lower free energy) neighbors in the graph
+  //! are compared to all frames.
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const Graph& graph,
+                    const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const std::vector<std::size_t>& original_ids = {});
+  //! graph with frames in given order, see \link Clustering::Tools::reordered.
+  //! an empty order leaves the graph unchanged.
+  Graph
+  reordered(const Graph& graph,
+            const std::vector<std::size_t>& order);
+  //! inverse of 'reordered' for graphs.
+  Graph
+  original_order(const Graph& graph,
+                 const std::vector<std::size_t>& order);
+  //! write graph to (binary) file, together with a fingerprint
+  //! of the data it was built from (see Clustering::Density::Tiles::fingerprint)
+  void
+  write_graph(const std::string filename,
+              const Graph& graph,
+              const uint64_t data_fingerprint);
+  //! read graph from (binary) file. the graph must have 'n_rows' frames
+  //! and the given data fingerprint, corrupt files are refused.
+  Graph
+  read_graph(const std::string filename,
+             const std::size_t n_rows,
+             const uint64_t data_fingerprint);
+} // end namespace NeighborGraph
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,540 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_hnsw.hpp"
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <iostream>
+
+namespace Clustering {
+namespace Density {
+namespace HNSW {
+
+  namespace {
+    //! fixed seed for frame levels: repeated runs give the same graph
+    const uint64_t LEVEL_SEED = 42;
+    //! highest level of the graph
+    const std::size_t MAX_LEVEL = 32;
+    //! max. number of frames inserted in parallel
+    const std::size_t MAX_BATCH_SIZE = 4096;
+
+    //! frame with its squared distance to the query frame
+    struct Candidate {
+      float dist2;
+      uint32_t id;
+    };
+
+    //! order by distance, ties broken by frame id
+    inline bool
+    closer(const Candidate& a, const Candidate& b) {
+      return a.dist2 < b.dist2 || (a.dist2 == b.dist2 && a.id < b.id);
+    }
+
+    inline bool
+    farther(const Candidate& a, const Candidate& b) {
+      return closer(b, a);
+    }
+
+    //! buffers of the beam search, per thread
+    struct SearchBuffers {
+      //! frames are visited in the current search if tagged with 'epoch'
+      std::vector<uint32_t> visited;
+      uint32_t epoch;
+      //! frames to expand (min-heap)
+      std::vector<Candidate> candidates;
+      //! closest frames found so far (max-heap)
+      std::vector<Candidate> results;
+      std::vector<std::size_t> ids;
+      std::vector<float> dist2;
+    };
+
+    //! random level of frame i with exponentially decreasing
+    //! probability, i.e. P(level >= l) = n_links^-l.
+    std::size_t
+    random_level(const std::size_t i,
+                 const std::size_t n_links) {
+      // splitmix64 of seeded frame id
+      uint64_t x = LEVEL_SEED + (i+1) * 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      // uniform in (0,1]
+      double u = ((x >> 11) + 1) * (1.0 / 9007199254740992.0);
+      std::size_t l = (std::size_t) (-std::log(u) / std::log((double) n_links));
+      return std::min(l, MAX_LEVEL);
+    }
+
+    //! max. number of links of a frame on level l
+    inline std::size_t
+    max_links(const Graph& g,
+              const std::size_t l) {
+      return (l == 0) ? 2*g.n_links : g.n_links;
+    }
+
+    //! link block of frame i on level l: number of links followed by the links
+    inline uint32_t*
+    link_block(Graph& g,
+               const std::size_t i,
+               const std::size_t l) {
+      if (l == 0) {
+        return &g.links0[i*(2*g.n_links+1)];
+      }
+      return &g.upper_links[g.upper_offset[i] + (l-1)*(g.n_links+1)];
+    }
+
+    inline const uint32_t*
+    link_block(const Graph& g,
+               const std::size_t i,
+               const std::size_t l) {
+      return link_block(const_cast<Graph&>(g), i, l);
+    }
+
+    /*!
+     * beam search for the 'ef' frames closest to 'query' on level l,
+     * starting from the frames given in 'entries'.
+     * the frames found are returned in 'entries' in ascending order.
+     */
+    void
+    search_level(const Graph& g,
+                 const float* coords,
+                 const std::size_t n_cols,
+                 const float* query,
+                 const std::size_t ef,
+                 const std::size_t l,
+                 std::vector<Candidate>& entries,
+                 SearchBuffers& buf) {
+      if (buf.visited.size() != g.n_rows) {
+        buf.visited.assign(g.n_rows, 0);
+        buf.epoch = 0;
+      }
+      ++buf.epoch;
+      if (buf.epoch == 0) {
+        std::fill(buf.visited.begin(), buf.visited.end(), 0);
+        buf.epoch = 1;
+      }
+      buf.candidates.clear();
+      buf.results.clear();
+      for (const Candidate& c: entries) {
+        buf.visited[c.id] = buf.epoch;
+        buf.candidates.push_back(c);
+        std::push_heap(buf.candidates.begin(), buf.candidates.end(), farther);
+        buf.results.push_back(c);
+        std::push_heap(buf.results.begin(), buf.results.end(), closer);
+        if (buf.results.size() > ef) {
+          std::pop_heap(buf.results.begin(), buf.results.end(), closer);
+          buf.results.pop_back();
+        }
+      }
+      while ( ! buf.candidates.empty()) {
+        std::pop_heap(buf.candidates.begin(), buf.candidates.end(), farther);
+        const Candidate c = buf.candidates.back();
+        buf.candidates.pop_back();
+        if (buf.results.size() >= ef && closer(buf.results.front(), c)) {
+          // all remaining candidates are farther than the results
+          break;
+        }
+        const uint32_t* block = link_block(g, c.id, l);
+        buf.ids.clear();
+        for (uint32_t s=1; s <= block[0]; ++s) {
+          if (buf.visited[block[s]] != buf.epoch) {
+            buf.visited[block[s]] = buf.epoch;
+            buf.ids.push_back(block[s]);
+          }
+        }
+        if (buf.dist2.size() < buf.ids.size()) {
+          buf.dist2.resize(buf.ids.size());
+        }
+        SIMD::squared_distances(query
+                              , coords
+                              , buf.ids.data()
+                              , buf.ids.size()
+                              , n_cols
+                              , buf.dist2.data());
+        for (std::size_t q=0; q < buf.ids.size(); ++q) {
+          const Candidate next = {buf.dist2[q], (uint32_t) buf.ids[q]};
+          if (buf.results.size() < ef || closer(next, buf.results.front())) {
+            buf.candidates.push_back(next);
+            std::push_heap(buf.candidates.begin(), buf.candidates.end(), farther);
+            buf.results.push_back(next);
+            std::push_heap(buf.results.begin(), buf.results.end(), closer);
+            if (buf.results.size() > ef) {
+              std::pop_heap(buf.results.begin(), buf.results.end(), closer);
+              buf.results.pop_back();
+            }
+          }
+        }
+      }
+      std::sort_heap(buf.results.begin(), buf.results.end(), closer);
+      entries.assign(buf.results.begin(), buf.results.end());
+    }
+
+    /*!
+     * select up to 'm' links from candidates (sorted by distance):
+     * a candidate is skipped if it is closer to an already selected
+     * one than to the frame itself, such that links point into
+     * different directions.
+     */
+    void
+    select_links(const float* coords,
+                 const std::size_t n_cols,
+                 const std::vector<Candidate>& sorted_candidates,
+                 const std::size_t m,
+                 std::vector<uint32_t>& links) {
+      links.clear();
+      for (const Candidate& c: sorted_candidates) {
+        if (links.size() >= m) {
+          break;
+        }
+        bool diverse = true;
+        for (uint32_t s: links) {
+          if (SIMD::squared_distance(&coords[c.id*n_cols], &coords[s*n_cols], n_cols) < c.dist2) {
+            diverse = false;
+            break;
+          }
+        }
+        if (diverse) {
+          links.push_back(c.id);
+        }
+      }
+    }
+
+    //! greedy search through the upper levels and beam search on level 0
+    void
+    search_graph(const Graph& g,
+                 const float* coords,
+                 const std::size_t n_cols,
+                 const std::size_t i,
+                 const std::size_t ef,
+                 std::vector<Candidate>& entries,
+                 SearchBuffers& buf) {
+      const float* query = &coords[i*n_cols];
+      entries.assign(1, {SIMD::squared_distance(query, &coords[g.entry_point*n_cols], n_cols)
+                       , (uint32_t) g.entry_point});
+      for (std::size_t l=g.max_level; l > 0; --l) {
+        search_level(g, coords, n_cols, query, 1, l, entries, buf);
+      }
+      search_level(g, coords, n_cols, query, ef, 0, entries, buf);
+    }
+  } // end local namespace
+
+  Graph
+  build_graph(const float* coords,
+              const std::size_t n_rows,
+              const std::size_t n_cols,
+              const Parameters& params) {
+    Graph g;
+    g.n_rows = n_rows;
+    g.n_links = std::max<std::size_t>(2, params.n_links);
+    g.entry_point = 0;
+    g.max_level = 0;
+    const std::size_t n_links = g.n_links;
+    const std::size_t ef = std::max(params.ef_construction, n_links);
+    g.level.resize(n_rows);
+    g.upper_offset.resize(n_rows);
+    std::size_t n_upper = 0;
+    for (std::size_t i=0; i < n_rows; ++i) {
+      g.level[i] = (uint8_t) random_level(i, n_links);
+      g.upper_offset[i] = n_upper;
+      n_upper += g.level[i] * (n_links+1);
+    }
+    g.links0.assign(n_rows*(2*n_links+1), 0);
+    g.upper_links.assign(n_upper, 0);
+    if (n_rows == 0) {
+      return g;
+    }
+    g.max_level = g.level[0];
+    // links of the frames of the current batch, per level
+    std::vector<std::vector<std::vector<uint32_t>>> new_links;
+    // back links of a batch: linked frame, level, new frame
+    std::vector<std::tuple<uint32_t, uint8_t, uint32_t>> back_links;
+    std::vector<std::size_t> group_offsets;
+    std::size_t n_inserted = 1;
+    while (n_inserted < n_rows) {
+      // batches grow with the graph, such that the frames
+      // of a batch are only a small fraction of the graph
+      const std::size_t batch_from = n_inserted;
+      const std::size_t n_batch = std::min(n_rows - n_inserted
+                                         , std::max<std::size_t>(1, std::min(MAX_BATCH_SIZE, n_inserted/8)));
+      new_links.resize(n_batch);
+      // search neighbors of new frames on the graph of previous batches
+      {
+        std::size_t b, i, l, l_top;
+        std::vector<Candidate> entries;
+        SearchBuffers buf;
+        #pragma omp parallel for default(none)\
+          private(b,i,l,l_top)\
+          firstprivate(batch_from,n_batch,n_cols,n_links,ef,entries,buf)\
+          shared(g,coords,new_links)\
+          schedule(dynamic,1)
+        for (b=0; b < n_batch; ++b) {
+          i = batch_from + b;
+          const float* query = &coords[i*n_cols];
+          entries.assign(1, {SIMD::squared_distance(query, &coords[g.entry_point*n_cols], n_cols)
+                           , (uint32_t) g.entry_point});
+          for (l=g.max_level; l > g.level[i]; --l) {
+            search_level(g, coords, n_cols, query, 1, l, entries, buf);
+          }
+          l_top = std::min<std::size_t>(g.level[i], g.max_level);
+          new_links[b].resize(l_top+1);
+          for (l=l_top+1; l > 0; --l) {
+            search_level(g, coords, n_cols, query, ef, l-1, entries, buf);
+            select_links(coords, n_cols, entries, n_links, new_links[b][l-1]);
+          }
+        }
+      }
+      // insert links of new frames and collect back links
+      back_links.clear();
+      for (std::size_t b=0; b < n_batch; ++b) {
+        const std::size_t i = batch_from + b;
+        for (std::size_t l=0; l < new_links[b].size(); ++l) {
+          uint32_t* block = link_block(g, i, l);
+          block[0] = new_links[b][l].size();
+          std::copy(new_links[b][l].begin(), new_links[b][l].end(), &block[1]);
+          for (uint32_t j: new_links[b][l]) {
+            back_links.emplace_back(j, (uint8_t) l, (uint32_t) i);
+          }
+        }
+      }
+      // back links per linked frame and level (in order of insertion),
+      // every group is handled by a single thread.
+      std::stable_sort(back_links.begin()
+                     , back_links.end()
+                     , [](const std::tuple<uint32_t, uint8_t, uint32_t>& a
+                        , const std::tuple<uint32_t, uint8_t, uint32_t>& b) -> bool {
+                         return std::get<0>(a) < std::get<0>(b)
+                             || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+                       });
+      group_offsets.clear();
+      for (std::size_t r=0; r < back_links.size(); ++r) {
+        if (r == 0
+         || std::get<0>(back_links[r]) != std::get<0>(back_links[r-1])
+         || std::get<1>(back_links[r]) != std::get<1>(back_links[r-1])) {
+          group_offsets.push_back(r);
+        }
+      }
+      group_offsets.push_back(back_links.size());
+      {
+        const std::size_t n_groups = group_offsets.size() - 1;
+        std::size_t i_group, r, s, j, l, cap;
+        std::vector<Candidate> candidates;
+        std::vector<uint32_t> links;
+        #pragma omp parallel for default(none)\
+          private(i_group,r,s,j,l,cap)\
+          firstprivate(n_groups,n_cols,candidates,links)\
+          shared(g,coords,back_links,group_offsets)\
+          schedule(dynamic,64)
+        for (i_group=0; i_group < n_groups; ++i_group) {
+          j = std::get<0>(back_links[group_offsets[i_group]]);
+          l = std::get<1>(back_links[group_offsets[i_group]]);
+          cap = max_links(g, l);
+          uint32_t* block = link_block(g, j, l);
+          for (r=group_offsets[i_group]; r < group_offsets[i_group+1]; ++r) {
+            const uint32_t i = std::get<2>(back_links[r]);
+            if (block[0] < cap) {
+              block[1+block[0]] = i;
+              ++block[0];
+            } else {
+              // too many links: re-select from old links and new frame
+              candidates.clear();
+              for (s=1; s <= block[0]; ++s) {
+                candidates.push_back({SIMD::squared_distance(&coords[j*n_cols], &coords[block[s]*n_cols], n_cols)
+                                    , block[s]});
+              }
+              candidates.push_back({SIMD::squared_distance(&coords[j*n_cols], &coords[i*n_cols], n_cols)
+                                  , i});
+              std::sort(candidates.begin(), candidates.end(), closer);
+              select_links(coords, n_cols, candidates, cap, links);
+              block[0] = links.size();
+              std::copy(links.begin(), links.end(), &block[1]);
+            }
+          }
+        }
+      }
+      // frames on new top levels become entry points
+      for (std::size_t i=batch_from; i < batch_from+n_batch; ++i) {
+        if (g.level[i] > g.max_level) {
+          g.max_level = g.level[i];
+          g.entry_point = i;
+        }
+      }
+      n_inserted += n_batch;
+    }
+    return g;
+  }
+
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const Parameters& params) {
+    Clustering::logger(std::cout) << "building HNSW graph" << std::endl;
+    const Graph g = build_graph(coords, n_rows, n_cols, params);
+    Clustering::logger(std::cout) << " HNSW: " << (g.max_level+1) << " levels, "
+                                  << g.n_links << " links per frame" << std::endl;
+    const std::size_t ef = std::max<std::size_t>(2, params.ef_search);
+    Neighborhood nh(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    Neighborhood nh_high_dens(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    const std::size_t chunk_size = 1024;
+    std::size_t i, j_from, n_chunk, q;
+    std::size_t n_exhaustive = 0;
+    bool found_nn, found_high_dens;
+    std::vector<Candidate> entries;
+    std::vector<float> dist2(chunk_size);
+    SearchBuffers buf;
+    #pragma omp parallel for default(none)\
+      private(i,j_from,n_chunk,q,found_nn,found_high_dens)\
+      firstprivate(n_rows,n_cols,ef,chunk_size,entries,dist2,buf)\
+      shared(g,coords,free_energy,nh,nh_high_dens)\
+      reduction(+:n_exhaustive)\
+      schedule(dynamic,256)
+    for (i=0; i < n_rows; ++i) {
+      search_graph(g, coords, n_cols, i, ef, entries, buf);
+      found_nn = false;
+      found_high_dens = false;
+      for (const Candidate& c: entries) {
+        if (c.id == i) {
+          continue;
+        }
+        if ( ! found_nn) {
+          nh.set(i, c.id, c.dist2);
+          found_nn = true;
+        }
+        if ( ! found_high_dens && free_energy[c.id] < free_energy[i]) {
+          nh_high_dens.set(i, c.id, c.dist2);
+          found_high_dens = true;
+        }
+      }
+      if ( ! found_high_dens) {
+        // e.g. frames at density maxima: their neighbors of
+        // lower free energy are far away, compare to all frames.
+        ++n_exhaustive;
+        for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+          n_chunk = std::min(chunk_size, n_rows-j_from);
+          SIMD::squared_distances(&coords[i*n_cols]
+                                , &coords[j_from*n_cols]
+                                , n_chunk
+                                , n_cols
+                                , dist2.data());
+          for (q=0; q < n_chunk; ++q) {
+            if (free_energy[j_from+q] < free_energy[i]
+             && dist2[q] < nh_high_dens.dist2[i]) {
+              nh_high_dens.set(i, j_from+q, dist2[q]);
+            }
+          }
+        }
+      }
+    }
+    Clustering::logger(std::cout) << " HNSW: " << n_exhaustive
+                                  << " frames searched exhaustively for neighbors of lower free energy"
+                                  << std::endl;
+    // approximate results must not go unnoticed:
+    // always report the estimated recall.
+    if (params.n_samples > 0) {
+      RecallEstimate rec = estimate_recall(coords, n_rows, n_cols, free_energy, nh, nh_high_dens, params.n_samples);
+      std::cout << "HNSW nearest neighbors: est. recall "
+                << rec.recall << " (nearest neighbor), "
+                << rec.recall_high_dens << " (neighbor of lower free energy) on "
+                << rec.n_samples << " sampled frames" << std::endl;
+    }
+    return std::make_tuple(nh, nh_high_dens);
+  }
+
+  RecallEstimate
+  estimate_recall(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols,
+                  const std::vector<float>& free_energy,
+                  const Neighborhood& nh,
+                  const Neighborhood& nh_high_dens,
+                  const std::size_t n_samples) {
+    const std::size_t n = std::min(n_samples, n_rows);
+    RecallEstimate rec = {n, 0.0, 0.0};
+    if (n == 0) {
+      return rec;
+    }
+    // random samples (fixed seed)
+    std::mt19937_64 rng(LEVEL_SEED);
+    std::uniform_int_distribution<std::size_t> uniform(0, n_rows-1);
+    std::vector<std::size_t> samples(n);
+    for (std::size_t s=0; s < n; ++s) {
+      samples[s] = uniform(rng);
+    }
+    const std::size_t chunk_size = 1024;
+    std::size_t s, i, j_from, n_chunk, q;
+    std::size_t n_hits = 0;
+    std::size_t n_hits_high_dens = 0;
+    float mindist, mindist_high_dens;
+    std::vector<float> dist2(chunk_size);
+    #pragma omp parallel for default(none)\
+      private(s,i,j_from,n_chunk,q,mindist,mindist_high_dens)\
+      firstprivate(n,n_rows,n_cols,chunk_size,dist2)\
+      shared(coords,free_energy,samples,nh,nh_high_dens)\
+      reduction(+:n_hits,n_hits_high_dens)\
+      schedule(dynamic,1)
+    for (s=0; s < n; ++s) {
+      i = samples[s];
+      mindist = std::numeric_limits<float>::max();
+      mindist_high_dens = std::numeric_limits<float>::max();
+      for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+        n_chunk = std::min(chunk_size, n_rows-j_from);
+        SIMD::squared_distances(&coords[i*n_cols]
+                              , &coords[j_from*n_cols]
+                              , n_chunk
+                              , n_cols
+                              , dist2.data());
+        for (q=0; q < n_chunk; ++q) {
+          if (j_from+q == i) {
+            continue;
+          }
+          mindist = std::min(mindist, dist2[q]);
+          if (free_energy[j_from+q] < free_energy[i]) {
+            mindist_high_dens = std::min(mindist_high_dens, dist2[q]);
+          }
+        }
+      }
+      // neighbors at the same distance are equally good
+      if (nh.dist2[i] == mindist) {
+        ++n_hits;
+      }
+      if (nh_high_dens.dist2[i] == mindist_high_dens) {
+        ++n_hits_high_dens;
+      }
+    }
+    rec.recall = (double) n_hits / n;
+    rec.recall_high_dens = (double) n_hits_high_dens / n;
+    return rec;
+  }
+
+} // end namespace HNSW
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+#include "density_clustering_common.hpp"
+
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+
+/*! \file
+ * approximate nearest neighbors via a hierarchical navigable
+ * small world (HNSW) graph.
+ *
+ * every frame is linked to a few of its neighbors on a stack of graph
+ * levels with exponentially decreasing numbers of frames. a greedy beam
+ * search through the levels finds (most of) the nearest neighbors of a
+ * frame with a number of distance computations growing only
+ * logarithmically with the number of frames, independently of the
+ * dimensionality of the data.
+ *
+ * the graph is built in batches of frames: the neighbors of all frames
+ * of a batch are searched in parallel on the graph of the previous
+ * batches, afterwards the links are updated. thus, repeated runs give
+ * the same results.
+ *
+ * results are APPROXIMATE, i.e. some frames may get a neighbor that is
+ * not the nearest one. the recall is estimated on a sample of frames.
+ */
+
+namespace Clustering {
+namespace Density {
+//! approximate nearest neighbor search on HNSW graphs
+namespace HNSW {
+  //! parameters of graph construction and search
+  struct Parameters {
+    //! number of links per frame on the upper levels (twice as many on level 0)
+    std::size_t n_links;
+    //! beam width of the neighbor search during graph construction
+    std::size_t ef_construction;
+    //! beam width of the nearest neighbor search.
+    //! larger values give higher recall at higher cost.
+    std::size_t ef_search;
+    //! number of sampled frames for recall estimation
+    std::size_t n_samples;
+  };
+  const Parameters DEFAULT_PARAMETERS = {16, 100, 64, 1000};
+  //! HNSW graph over all frames
+  struct Graph {
+    std::size_t n_rows;
+    std::size_t n_links;
+    //! frame to start every search from (on the top level)
+    std::size_t entry_point;
+    std::size_t max_level;
+    //! top level of every frame
+    std::vector<uint8_t> level;
+    //! link blocks of level 0, format: [frame * (2*n_links+1) + slot],
+    //! with the number of links in slot 0 followed by the linked frames.
+    std::vector<uint32_t> links0;
+    //! offset of the frame's link blocks in 'upper_links'
+    std::vector<std::size_t> upper_offset;
+    //! link blocks of levels > 0, format: [upper_offset[frame] + (level-1) * (n_links+1) + slot]
+    std::vector<uint32_t> upper_links;
+  };
+  //! estimated recall of approximate nearest neighbors
+  struct RecallEstimate {
+    std::size_t n_samples;
+    //! fraction of sampled frames with exact nearest neighbor
+    double recall;
+    //! fraction of sampled frames with exact nearest neighbor of lower free energy
+    double recall_high_dens;
+  };
+  //! build graph by inserting frames in order
+  Graph
+  build_graph(const float* coords,
+              const std::size_t n_rows,
+              const std::size_t n_cols,
+              const Parameters& params = DEFAULT_PARAMETERS);
+  //! approximate implementation of
+  //! \link Clustering::Density::nearest_neighbors
+  //! frames without any candidate of lower free energy in the search beam
+  //! are compared to all frames for their neighbor of lower free energy.
+  //! the recall is estimated on 'params.n_samples' frames and printed.
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const Parameters& params = DEFAULT_PARAMETERS);
+  //! compare given neighborhoods to exact nearest neighbors
+  //! of 'n_samples' randomly chosen frames.
+  RecallEstimate
+  estimate_recall(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols,
+                  const std::vector<float>& free_energy,
+                  const Neighborhood& nh,
+                  const Neighborhood& nh_high_dens,
+                  const std::size_t n_samples);
+} // end namespace HNSW
+} // end namespace Density
+} // end namespace Clustering
+
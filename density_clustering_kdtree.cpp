@@ -0,0 +1,642 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_kdtree.hpp"
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace Clustering {
+namespace Density {
+namespace KDTree {
+
+  namespace {
+    /*!
+     * count neighbors of frame at tree position 'pos' in node 'i_node'
+     * for the radii given by the index range [l_from, l_to).
+     * squared radii are expected in descending order.
+     *
+     * nodes completely inside of a radius are counted as a whole,
+     * nodes completely outside are skipped. only frames of leaves
+     * on the boundary of the hypersphere are compared directly,
+     * using 'dist2' as buffer for the distances.
+     */
+    void
+    count_neighbors(const Tree& tree,
+                    const std::size_t i_node,
+                    const std::size_t pos,
+                    const std::vector<float>& rad2,
+                    std::size_t l_from,
+                    std::size_t l_to,
+                    std::vector<std::size_t>& counts,
+                    std::vector<float>& dist2) {
+      const std::size_t n_cols = tree.n_cols;
+      const Node& node = tree.nodes[i_node];
+      const float* ref = &tree.coords[pos*n_cols];
+      const float* lower = &tree.lower[i_node*n_cols];
+      const float* upper = &tree.upper[i_node*n_cols];
+      // min. and max. squared distance of reference to bounding box
+      float min_dist2 = 0.0f;
+      float max_dist2 = 0.0f;
+      for (std::size_t k=0; k < n_cols; ++k) {
+        float d_lower = ref[k] - lower[k];
+        float d_upper = upper[k] - ref[k];
+        if (d_lower < 0.0f) {
+          min_dist2 += d_lower*d_lower;
+        } else if (d_upper < 0.0f) {
+          min_dist2 += d_upper*d_upper;
+        }
+        float d_max = std::max(std::abs(d_lower), std::abs(d_upper));
+        max_dist2 += d_max*d_max;
+      }
+      // radii completely enclosing the node
+      std::size_t l_inside = l_from;
+      while (l_inside < l_to
+          && max_dist2 < rad2[l_inside] * (1.0f - tree.tolerance)) {
+        ++l_inside;
+      }
+      if (l_inside != l_from) {
+        std::size_t n_frames = node.to - node.from;
+        if (node.from <= pos && pos < node.to) {
+          // do not count reference frame itself
+          --n_frames;
+        }
+        for (std::size_t l=l_from; l < l_inside; ++l) {
+          counts[l] += n_frames;
+        }
+      }
+      // radii not touching the node
+      while (l_to > l_inside
+          && min_dist2 > rad2[l_to-1] * (1.0f + tree.tolerance)) {
+        --l_to;
+      }
+      if (l_inside == l_to) {
+        return;
+      }
+      if (node.left == 0) {
+        // leaf: compare frames directly
+        std::size_t j, l;
+        const std::size_t n_leaf_frames = node.to - node.from;
+        if (dist2.size() < n_leaf_frames) {
+          dist2.resize(n_leaf_frames);
+        }
+        SIMD::squared_distances(ref
+                              , &tree.coords[node.from*n_cols]
+                              , n_leaf_frames
+                              , n_cols
+                              , dist2.data());
+        for (j=0; j < n_leaf_frames; ++j) {
+          if (node.from+j != pos) {
+            for (l=l_inside; l < l_to; ++l) {
+              if (dist2[j] < rad2[l]) {
+                counts[l] += 1;
+              } else {
+                // if it's not in the bigger radius,
+                // it won't be in the smaller ones.
+                break;
+              }
+            }
+          }
+        }
+      } else {
+        count_neighbors(tree, node.left, pos, rad2, l_inside, l_to, counts, dist2);
+        count_neighbors(tree, node.right, pos, rad2, l_inside, l_to, counts, dist2);
+      }
+    }
+
+    //! nearest neighbor candidate: squared distance and frame id
+    struct Candidate {
+      float dist2;
+      std::size_t id;
+    };
+
+    //! is 'dist2' of frame 'id' better than the candidate?
+    //! ties are broken by lowest frame id (in the tree's original ids),
+    //! as in a brute-force search over ascending frame ids.
+    bool
+    is_closer(const Tree& tree,
+              const float dist2,
+              const std::size_t id,
+              const Candidate& cand) {
+      return dist2 < cand.dist2
+          || (dist2 == cand.dist2
+           && cand.dist2 < std::numeric_limits<float>::max()
+           && tie_id(tree.original_ids, id) < tie_id(tree.original_ids, cand.id));
+    }
+
+    //! min. squared distance of reference to bounding box of node
+    float
+    min_box_dist2(const Tree& tree,
+                  const std::size_t i_node,
+                  const float* ref) {
+      const std::size_t n_cols = tree.n_cols;
+      const float* lower = &tree.lower[i_node*n_cols];
+      const float* upper = &tree.upper[i_node*n_cols];
+      float min_dist2 = 0.0f;
+      for (std::size_t k=0; k < n_cols; ++k) {
+        float d_lower = lower[k] - ref[k];
+        float d_upper = ref[k] - upper[k];
+        if (d_lower > 0.0f) {
+          min_dist2 += d_lower*d_lower;
+        } else if (d_upper > 0.0f) {
+          min_dist2 += d_upper*d_upper;
+        }
+      }
+      return min_dist2;
+    }
+
+    /*!
+     * search nearest neighbor ('nn') and nearest neighbor with lower free
+     * energy ('nn_high_dens') of frame at tree position 'pos' in node 'i_node'.
+     * nodes are skipped if their bounding box is definitely farther away than
+     * the current candidates (or all their frames have free energies not below
+     * 'fe_ref' for the high density neighbor).
+     * 'min_dist2' is the precomputed min. squared distance to the node's box.
+     */
+    void
+    search_neighbors(const Tree& tree,
+                     const std::size_t i_node,
+                     const float min_dist2,
+                     const std::size_t pos,
+                     const std::vector<float>& free_energy,
+                     const std::vector<float>& node_min_fe,
+                     const float fe_ref,
+                     Candidate& nn,
+                     Candidate& nn_high_dens,
+                     std::vector<float>& dist2) {
+      const float tol = 1.0f + tree.tolerance;
+      if (min_dist2 > nn.dist2 * tol
+       && (node_min_fe[i_node] >= fe_ref
+        || min_dist2 > nn_high_dens.dist2 * tol)) {
+        return;
+      }
+      const std::size_t n_cols = tree.n_cols;
+      const Node& node = tree.nodes[i_node];
+      const float* ref = &tree.coords[pos*n_cols];
+      if (node.left == 0) {
+        // leaf: compare frames directly
+        const std::size_t n_leaf_frames = node.to - node.from;
+        if (dist2.size() < n_leaf_frames) {
+          dist2.resize(n_leaf_frames);
+        }
+        SIMD::squared_distances(ref
+                              , &tree.coords[node.from*n_cols]
+                              , n_leaf_frames
+                              , n_cols
+                              , dist2.data());
+        for (std::size_t j=0; j < n_leaf_frames; ++j) {
+          if (node.from+j != pos) {
+            const std::size_t id = tree.frames[node.from+j];
+            if (is_closer(tree, dist2[j], id, nn)) {
+              nn = {dist2[j], id};
+            }
+            if (free_energy[id] < fe_ref
+             && is_closer(tree, dist2[j], id, nn_high_dens)) {
+              nn_high_dens = {dist2[j], id};
+            }
+          }
+        }
+      } else {
+        // closer child first to tighten the candidates early
+        float min_dist2_left = min_box_dist2(tree, node.left, ref);
+        float min_dist2_right = min_box_dist2(tree, node.right, ref);
+        if (min_dist2_left <= min_dist2_right) {
+          search_neighbors(tree, node.left, min_dist2_left, pos, free_energy, node_min_fe, fe_ref, nn, nn_high_dens, dist2);
+          search_neighbors(tree, node.right, min_dist2_right, pos, free_energy, node_min_fe, fe_ref, nn, nn_high_dens, dist2);
+        } else {
+          search_neighbors(tree, node.right, min_dist2_right, pos, free_energy, node_min_fe, fe_ref, nn, nn_high_dens, dist2);
+          search_neighbors(tree, node.left, min_dist2_left, pos, free_energy, node_min_fe, fe_ref, nn, nn_high_dens, dist2);
+        }
+      }
+    }
+
+    /*!
+     * search nearest neighbor of frame at tree position 'pos' among the
+     * frames inserted into the index so far ('active' per tree position,
+     * 'n_active' per node). nodes without active frames and nodes definitely
+     * farther away than the current candidate are skipped.
+     */
+    void
+    search_active_neighbor(const Tree& tree,
+                           const std::size_t i_node,
+                           const float min_dist2,
+                           const std::size_t pos,
+                           const std::vector<char>& active,
+                           const std::vector<std::size_t>& n_active,
+                           Candidate& nn,
+                           std::vector<float>& dist2) {
+      if (n_active[i_node] == 0
+       || min_dist2 > nn.dist2 * (1.0f + tree.tolerance)) {
+        return;
+      }
+      const std::size_t n_cols = tree.n_cols;
+      const Node& node = tree.nodes[i_node];
+      const float* ref = &tree.coords[pos*n_cols];
+      if (node.left == 0) {
+        const std::size_t n_leaf_frames = node.to - node.from;
+        if (dist2.size() < n_leaf_frames) {
+          dist2.resize(n_leaf_frames);
+        }
+        SIMD::squared_distances(ref
+                              , &tree.coords[node.from*n_cols]
+                              , n_leaf_frames
+                              , n_cols
+                              , dist2.data());
+        for (std::size_t j=0; j < n_leaf_frames; ++j) {
+          if (active[node.from+j]) {
+            const std::size_t id = tree.frames[node.from+j];
+            if (is_closer(tree, dist2[j], id, nn)) {
+              nn = {dist2[j], id};
+            }
+          }
+        }
+      } else {
+        float min_dist2_left = min_box_dist2(tree, node.left, ref);
+        float min_dist2_right = min_box_dist2(tree, node.right, ref);
+        if (min_dist2_left <= min_dist2_right) {
+          search_active_neighbor(tree, node.left, min_dist2_left, pos, active, n_active, nn, dist2);
+          search_active_neighbor(tree, node.right, min_dist2_right, pos, active, n_active, nn, dist2);
+        } else {
+          search_active_neighbor(tree, node.right, min_dist2_right, pos, active, n_active, nn, dist2);
+          search_active_neighbor(tree, node.left, min_dist2_left, pos, active, n_active, nn, dist2);
+        }
+      }
+    }
+  } // end local namespace
+
+  Tree
+  build_tree(const float* coords,
+             const std::size_t n_rows,
+             const std::size_t n_cols) {
+    Tree tree;
+    tree.n_rows = n_rows;
+    tree.n_cols = n_cols;
+    // rounding errors of squared distances grow linearly with
+    // the number of summed up dimensions
+    tree.tolerance = 4.0f * (n_cols + 2) * std::numeric_limits<float>::epsilon();
+    tree.frames.resize(n_rows);
+    std::iota(tree.frames.begin(), tree.frames.end(), 0);
+    tree.nodes.push_back({0, n_rows, 0, 0});
+    tree.lower.resize(n_cols);
+    tree.upper.resize(n_cols);
+    std::vector<std::size_t> unprocessed = {0};
+    while ( ! unprocessed.empty()) {
+      std::size_t i_node = unprocessed.back();
+      unprocessed.pop_back();
+      const std::size_t from = tree.nodes[i_node].from;
+      const std::size_t to = tree.nodes[i_node].to;
+      // tight bounding box of node
+      float* lower = &tree.lower[i_node*n_cols];
+      float* upper = &tree.upper[i_node*n_cols];
+      for (std::size_t k=0; k < n_cols; ++k) {
+        lower[k] = std::numeric_limits<float>::max();
+        upper[k] = std::numeric_limits<float>::lowest();
+      }
+      for (std::size_t p=from; p < to; ++p) {
+        const float* x = &coords[tree.frames[p]*n_cols];
+        for (std::size_t k=0; k < n_cols; ++k) {
+          lower[k] = std::min(lower[k], x[k]);
+          upper[k] = std::max(upper[k], x[k]);
+        }
+      }
+      if (to - from <= LEAF_SIZE) {
+        continue;
+      }
+      // split at median of dimension with largest spread
+      std::size_t split_dim = 0;
+      for (std::size_t k=1; k < n_cols; ++k) {
+        if (upper[k] - lower[k] > upper[split_dim] - lower[split_dim]) {
+          split_dim = k;
+        }
+      }
+      if ( ! (lower[split_dim] < upper[split_dim])) {
+        // all frames identical, no split possible
+        continue;
+      }
+      std::size_t mid = from + (to - from) / 2;
+      std::nth_element(tree.frames.begin() + from
+                     , tree.frames.begin() + mid
+                     , tree.frames.begin() + to
+                     , [&](std::size_t i, std::size_t j) -> bool {
+                         return coords[i*n_cols+split_dim] < coords[j*n_cols+split_dim];
+                       });
+      std::size_t i_left = tree.nodes.size();
+      tree.nodes[i_node].left = i_left;
+      tree.nodes[i_node].right = i_left + 1;
+      tree.nodes.push_back({from, mid, 0, 0});
+      tree.nodes.push_back({mid, to, 0, 0});
+      tree.lower.resize(tree.nodes.size()*n_cols);
+      tree.upper.resize(tree.nodes.size()*n_cols);
+      unprocessed.push_back(i_left);
+      unprocessed.push_back(i_left + 1);
+    }
+    // copy coordinates in tree order for cache-friendly access
+    tree.coords.resize(n_rows*n_cols);
+    for (std::size_t p=0; p < n_rows; ++p) {
+      std::copy(&coords[tree.frames[p]*n_cols]
+              , &coords[tree.frames[p]*n_cols] + n_cols
+              , &tree.coords[p*n_cols]);
+    }
+    return tree;
+  }
+
+  Pops
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        std::vector<float> radii) {
+    std::sort(radii.begin(), radii.end(), std::greater<float>());
+    std::size_t n_radii = radii.size();
+    std::vector<float> rad2(n_radii);
+    for (std::size_t l=0; l < n_radii; ++l) {
+      rad2[l] = radii[l]*radii[l];
+    }
+    Clustering::logger(std::cout) << "setting up k-d tree for fast NN search" << std::endl;
+    Tree tree = build_tree(coords, n_rows, n_cols);
+    Clustering::logger(std::cout) << " k-d tree: "
+                                  << tree.nodes.size()
+                                  << " nodes"
+                                  << std::endl;
+    Clustering::logger(std::cout) << "computing pops" << std::endl;
+    // pops per radius index; every frame is only written by the
+    // thread that handles it, so no synchronization is needed.
+    std::vector<std::vector<std::size_t>> pops_buf(n_radii
+                                                 , std::vector<std::size_t>(n_rows));
+    std::size_t pos, l;
+    std::vector<std::size_t> counts;
+    std::vector<float> dist2(LEAF_SIZE);
+    #pragma omp parallel for default(none)\
+      private(pos,l)\
+      firstprivate(n_rows,n_radii,counts,dist2)\
+      shared(tree,rad2,pops_buf)\
+      schedule(dynamic,256)
+    for (pos=0; pos < n_rows; ++pos) {
+      // every frame counts itself
+      counts.assign(n_radii, 1);
+      count_neighbors(tree, 0, pos, rad2, 0, n_radii, counts, dist2);
+      for (l=0; l < n_radii; ++l) {
+        pops_buf[l][tree.frames[pos]] = counts[l];
+      }
+    }
+    Pops pops;
+    for (l=0; l < n_radii; ++l) {
+      pops[radii[l]] = std::move(pops_buf[l]);
+    }
+    return pops;
+  }
+
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const Tiles::Parameters& tiles,
+                    const std::vector<std::size_t>& original_ids) {
+    Clustering::logger(std::cout) << "setting up k-d tree for fast NN search" << std::endl;
+    Tree tree = build_tree(coords, n_rows, n_cols);
+    tree.original_ids = original_ids;
+    Clustering::logger(std::cout) << " k-d tree: "
+                                  << tree.nodes.size()
+                                  << " nodes"
+                                  << std::endl;
+    // min. free energy per node. children are always stored
+    // after their parents, i.e. reverse order is bottom-up.
+    std::vector<float> node_min_fe(tree.nodes.size());
+    for (std::size_t i_node=tree.nodes.size(); i_node-- > 0; ) {
+      const Node& node = tree.nodes[i_node];
+      if (node.left == 0) {
+        float min_fe = std::numeric_limits<float>::infinity();
+        for (std::size_t p=node.from; p < node.to; ++p) {
+          min_fe = std::min(min_fe, free_energy[tree.frames[p]]);
+        }
+        node_min_fe[i_node] = min_fe;
+      } else {
+        node_min_fe[i_node] = std::min(node_min_fe[node.left]
+                                     , node_min_fe[node.right]);
+      }
+    }
+    // neighbors per frame; every frame is only written by the
+    // thread that handles it, so no synchronization is needed.
+    const Candidate no_neighbor = {std::numeric_limits<float>::max(), n_rows+1};
+    std::vector<Candidate> nn_buf(n_rows, no_neighbor);
+    std::vector<Candidate> nn_high_dens_buf(n_rows, no_neighbor);
+    // tiles of 'tile_size' consecutive tree positions,
+    // a single tile without checkpoints
+    const std::size_t tile_size = (tiles.filename.empty() ? std::max(n_rows, (std::size_t) 1) : tiles.tile_size);
+    const std::size_t n_tiles = (n_rows + tile_size - 1) / tile_size;
+    // 4 values per frame, see below
+    std::vector<std::size_t> n_tile_values(n_tiles);
+    for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+      n_tile_values[i_tile] = 4 * (std::min(n_rows, (i_tile+1)*tile_size) - i_tile*tile_size);
+    }
+    uint64_t input_fingerprint = 0;
+    if ( ! tiles.filename.empty()) {
+      const uint64_t tile_params[1] = {tile_size};
+      input_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float));
+      input_fingerprint = Tiles::fingerprint(free_energy.data(), n_rows*sizeof(float), input_fingerprint);
+      input_fingerprint = Tiles::fingerprint(tile_params, sizeof(tile_params), input_fingerprint);
+      input_fingerprint = Tiles::fingerprint(original_ids.data(), original_ids.size()*sizeof(std::size_t), input_fingerprint);
+    }
+    // tiles follow the tree order, i.e. are not
+    // interchangeable with those of the brute-force search.
+    Tiles::Checkpoint checkpoint = Tiles::open_checkpoint(tiles, "k-d tree nearest neighbor", n_tile_values, input_fingerprint);
+    std::vector<uint64_t> tile_values;
+    std::size_t pos, id;
+    Candidate nn, nn_high_dens;
+    std::vector<float> dist2(LEAF_SIZE);
+    for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+      const std::size_t pos_from = i_tile*tile_size;
+      const std::size_t pos_to = std::min(n_rows, pos_from+tile_size);
+      if (checkpoint.done[i_tile]) {
+        // format: [(pos - pos_from) * 4 + {id, dist2, id high dens, dist2 high dens}]
+        const std::vector<uint64_t>& values = checkpoint.values[i_tile];
+        for (pos=pos_from; pos < pos_to; ++pos) {
+          id = tree.frames[pos];
+          nn_buf[id] = {Tiles::value_float(values[4*(pos-pos_from)+1]), values[4*(pos-pos_from)]};
+          nn_high_dens_buf[id] = {Tiles::value_float(values[4*(pos-pos_from)+3]), values[4*(pos-pos_from)+2]};
+        }
+        continue;
+      }
+      #pragma omp parallel for default(none)\
+        private(pos,id,nn,nn_high_dens)\
+        firstprivate(pos_from,pos_to,no_neighbor,dist2)\
+        shared(tree,free_energy,node_min_fe,nn_buf,nn_high_dens_buf)\
+        schedule(dynamic,256)
+      for (pos=pos_from; pos < pos_to; ++pos) {
+        id = tree.frames[pos];
+        nn = no_neighbor;
+        nn_high_dens = no_neighbor;
+        search_neighbors(tree
+                       , 0
+                       , 0.0f
+                       , pos
+                       , free_energy
+                       , node_min_fe
+                       , free_energy[id]
+                       , nn
+                       , nn_high_dens
+                       , dist2);
+        nn_buf[id] = nn;
+        nn_high_dens_buf[id] = nn_high_dens;
+      }
+      if (checkpoint.enabled) {
+        tile_values.resize(4*(pos_to-pos_from));
+        for (pos=pos_from; pos < pos_to; ++pos) {
+          id = tree.frames[pos];
+          tile_values[4*(pos-pos_from)] = nn_buf[id].id;
+          tile_values[4*(pos-pos_from)+1] = Tiles::float_value(nn_buf[id].dist2);
+          tile_values[4*(pos-pos_from)+2] = nn_high_dens_buf[id].id;
+          tile_values[4*(pos-pos_from)+3] = Tiles::float_value(nn_high_dens_buf[id].dist2);
+        }
+        Tiles::save_tile(checkpoint, i_tile, tile_values);
+      }
+    }
+    Neighborhood nh(n_rows, 0, 0.0f);
+    Neighborhood nh_high_dens(n_rows, 0, 0.0f);
+    for (std::size_t i=0; i < n_rows; ++i) {
+      nh.set(i, nn_buf[i].id, nn_buf[i].dist2);
+      nh_high_dens.set(i, nn_high_dens_buf[i].id, nn_high_dens_buf[i].dist2);
+    }
+    return std::make_tuple(nh, nh_high_dens);
+  }
+
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors_incremental(const float* coords,
+                                const std::size_t n_rows,
+                                const std::size_t n_cols,
+                                const std::vector<float>& free_energy,
+                                const std::vector<std::size_t>& original_ids) {
+    Clustering::logger(std::cout) << "setting up k-d tree for fast NN search" << std::endl;
+    Tree tree = build_tree(coords, n_rows, n_cols);
+    tree.original_ids = original_ids;
+    Clustering::logger(std::cout) << " k-d tree: "
+                                  << tree.nodes.size()
+                                  << " nodes"
+                                  << std::endl;
+    const std::size_t n_nodes = tree.nodes.size();
+    // parent of every node and leaf of every tree position,
+    // to update the number of active frames on insertion
+    std::vector<std::size_t> parent(n_nodes, 0);
+    std::vector<std::size_t> leaf(n_rows, 0);
+    for (std::size_t i_node=0; i_node < n_nodes; ++i_node) {
+      const Node& node = tree.nodes[i_node];
+      if (node.left == 0) {
+        for (std::size_t p=node.from; p < node.to; ++p) {
+          leaf[p] = i_node;
+        }
+      } else {
+        parent[node.left] = i_node;
+        parent[node.right] = i_node;
+      }
+    }
+    std::vector<std::size_t> pos_of_frame(n_rows);
+    for (std::size_t p=0; p < n_rows; ++p) {
+      pos_of_frame[tree.frames[p]] = p;
+    }
+    const Candidate no_neighbor = {std::numeric_limits<float>::max(), n_rows+1};
+    std::vector<Candidate> nn_buf(n_rows, no_neighbor);
+    std::vector<Candidate> nn_high_dens_buf(n_rows, no_neighbor);
+    std::vector<float> dist2(LEAF_SIZE);
+    // plain nearest neighbors on the static tree
+    // (free energies below -inf do not exist, i.e. no high density search)
+    {
+      std::vector<float> node_min_fe(n_nodes, 0.0f);
+      const float no_fe = -std::numeric_limits<float>::infinity();
+      std::size_t pos;
+      Candidate nn, nn_high_dens;
+      #pragma omp parallel for default(none)\
+        private(pos,nn,nn_high_dens)\
+        firstprivate(n_rows,no_neighbor,no_fe,dist2)\
+        shared(tree,free_energy,node_min_fe,nn_buf)\
+        schedule(dynamic,256)
+      for (pos=0; pos < n_rows; ++pos) {
+        nn = no_neighbor;
+        nn_high_dens = no_neighbor;
+        search_neighbors(tree, 0, 0.0f, pos, free_energy, node_min_fe, no_fe, nn, nn_high_dens, dist2);
+        nn_buf[tree.frames[pos]] = nn;
+      }
+    }
+    // neighbors with lower free energy: frames are inserted into the index
+    // in order of ascending free energy, after all frames of the same free
+    // energy have been queried. every query then is a plain nearest neighbor
+    // search among the frames in the index.
+    {
+      std::vector<FreeEnergy> fe_sorted = sorted_free_energies(free_energy);
+      std::vector<char> active(n_rows, 0);
+      std::vector<std::size_t> n_active(n_nodes, 0);
+      std::size_t group_from = 0;
+      std::size_t k, pos;
+      Candidate nn;
+      while (group_from < n_rows) {
+        std::size_t group_to = group_from + 1;
+        while (group_to < n_rows
+            && fe_sorted[group_to].second == fe_sorted[group_from].second) {
+          ++group_to;
+        }
+        // query all frames of same free energy
+        #pragma omp parallel for default(none)\
+          private(k,pos,nn)\
+          firstprivate(group_from,group_to,no_neighbor,dist2)\
+          shared(tree,fe_sorted,pos_of_frame,active,n_active,nn_high_dens_buf)\
+          schedule(dynamic,16)\
+          if(group_to - group_from > 64)
+        for (k=group_from; k < group_to; ++k) {
+          pos = pos_of_frame[fe_sorted[k].first];
+          nn = no_neighbor;
+          search_active_neighbor(tree, 0, 0.0f, pos, active, n_active, nn, dist2);
+          nn_high_dens_buf[fe_sorted[k].first] = nn;
+        }
+        // insert them into the index
+        for (k=group_from; k < group_to; ++k) {
+          pos = pos_of_frame[fe_sorted[k].first];
+          active[pos] = 1;
+          std::size_t i_node = leaf[pos];
+          while (true) {
+            ++n_active[i_node];
+            if (i_node == 0) {
+              break;
+            }
+            i_node = parent[i_node];
+          }
+        }
+        group_from = group_to;
+      }
+    }
+    Neighborhood nh(n_rows, 0, 0.0f);
+    Neighborhood nh_high_dens(n_rows, 0, 0.0f);
+    for (std::size_t i=0; i < n_rows; ++i) {
+      nh.set(i, nn_buf[i].id, nn_buf[i].dist2);
+      nh_high_dens.set(i, nn_high_dens_buf[i].id, nn_high_dens_buf[i].dist2);
+    }
+    return std::make_tuple(nh, nh_high_dens);
+  }
+
+} // end namespace KDTree
+} // end namespace Density
+} // end namespace Clustering
+
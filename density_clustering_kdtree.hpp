@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "config.hpp"
+#include "density_clustering_common.hpp"
+
+#include <vector>
+#include <map>
+#include <tuple>
+
+/*! \file
+ * k-d tree spatial index for density computations.
+ * in contrast to the box grid (which only separates the first two
+ * dimensions), the tree prunes on all dimensions of the input data.
+ */
+
+namespace Clustering {
+namespace Density {
+//! k-d tree implementations of compute intensive functions
+namespace KDTree {
+  //! max. number of frames per leaf node
+  const std::size_t LEAF_SIZE = 32;
+  //! single node of the k-d tree.
+  //! covers all frames from 'from' to 'to' (excluding) in tree order.
+  struct Node {
+    std::size_t from;
+    std::size_t to;
+    //! index of child nodes. leaves have no children (i.e. left == right == 0).
+    std::size_t left;
+    std::size_t right;
+  };
+  //! k-d tree with frames re-ordered to tree order and
+  //! tight bounding boxes for every node.
+  struct Tree {
+    std::size_t n_rows;
+    std::size_t n_cols;
+    //! frame ids in tree order
+    std::vector<std::size_t> frames;
+    //! coordinates in tree order, format: [position * n_cols + col]
+    std::vector<float> coords;
+    //! nodes of the tree, root is at index 0
+    std::vector<Node> nodes;
+    //! lower limits of node's bounding boxes, format: [node * n_cols + col]
+    std::vector<float> lower;
+    //! upper limits of node's bounding boxes, format: [node * n_cols + col]
+    std::vector<float> upper;
+    //! relative tolerance for bounding box comparisons.
+    //! bounds are only used for pruning / inclusion if they are
+    //! off by more than the rounding error of the distance computation,
+    //! thus guaranteeing exactly the same results as brute-force comparison.
+    float tolerance;
+    //! original frame ids to decide between neighbors of equal distance
+    //! (see Clustering::Density::tie_id), empty for lowest frame id.
+    std::vector<std::size_t> original_ids;
+  };
+  //! build k-d tree over all frames by median splits
+  //! along the dimension of largest spread.
+  Tree
+  build_tree(const float* coords,
+             const std::size_t n_rows,
+             const std::size_t n_cols);
+  //! k-d tree implementation of
+  //! \link Clustering::Density::calculate_populations(const float* coords, const std::size_t n_rows, const std::size_t n_cols, const std::vector<float> radii)
+  //! results are exactly the same as for the box-assisted search.
+  Pops
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        std::vector<float> radii);
+  //! k-d tree implementation of
+  //! \link Clustering::Density::nearest_neighbors
+  //! nodes are pruned if they cannot hold a frame closer than the current
+  //! nearest neighbor (or, for the neighbor with lower free energy, if all
+  //! of their frames have higher free energies). ties are broken by lowest
+  //! frame id (or lowest id in 'original_ids'), thus results are exactly
+  //! the same as for the brute-force search.
+  //! with a checkpoint file, frames are queried in tiles of consecutive
+  //! tree positions that are saved when finished (see Clustering::Density::Tiles).
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors(const float* coords,
+                    const std::size_t n_rows,
+                    const std::size_t n_cols,
+                    const std::vector<float>& free_energy,
+                    const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS,
+                    const std::vector<std::size_t>& original_ids = {});
+  //! k-d tree implementation of
+  //! \link Clustering::Density::nearest_neighbors
+  //! with a density-ordered incremental index for the neighbors with
+  //! lower free energy: frames are queried and inserted in order of
+  //! ascending free energy (frames of equal free energy are queried
+  //! before any of them is inserted). the query for the neighbor with
+  //! lower free energy thus becomes a plain nearest neighbor search among
+  //! the inserted frames, pruned on all dimensions.
+  //! results are exactly the same as for the brute-force search.
+  std::tuple<Neighborhood, Neighborhood>
+  nearest_neighbors_incremental(const float* coords,
+                                const std::size_t n_rows,
+                                const std::size_t n_cols,
+                                const std::vector<float>& free_energy,
+                                const std::vector<std::size_t>& original_ids = {});
+} // end namespace KDTree
+} // end namespace Density
+} // end namespace Clustering
+
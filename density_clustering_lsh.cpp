@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_lsh.hpp"
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+#include <cstdlib>
+
+namespace Clustering {
+namespace Density {
+namespace LSH {
+
+  namespace {
+    //! fixed seed for random projections: repeated runs give the same results
+    const uint64_t PROJECTION_SEED = 42;
+
+    //! combine bucket key with hash value of a single projection
+    uint64_t
+    mix(uint64_t key, const int64_t h) {
+      key ^= (uint64_t) h + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+      // splitmix64 finalizer
+      key ^= key >> 30;
+      key *= 0xbf58476d1ce4e5b9ULL;
+      key ^= key >> 27;
+      key *= 0x94d049bb133111ebULL;
+      key ^= key >> 31;
+      return key;
+    }
+  } // end local namespace
+
+  std::map<float, std::vector<std::size_t>>
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        std::vector<float> radii,
+                        const Parameters& params) {
+    if (params.n_tables == 0 || params.n_hashes == 0 || ! (params.bucket_width > 0.0f)) {
+      std::cerr << "error: LSH needs at least one table, one hash per table"
+                << " and a positive bucket width." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::sort(radii.begin(), radii.end(), std::greater<float>());
+    const std::size_t n_radii = radii.size();
+    std::vector<float> rad2(n_radii);
+    for (std::size_t l=0; l < n_radii; ++l) {
+      rad2[l] = radii[l]*radii[l];
+    }
+    const std::size_t n_tables = params.n_tables;
+    const std::size_t n_hashes = params.n_hashes;
+    const std::size_t n_proj = n_tables*n_hashes;
+    const double w = (double) params.bucket_width * radii[0];
+    // p-stable projections: gaussian directions, uniform offsets
+    std::mt19937_64 rng(PROJECTION_SEED);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, w);
+    std::vector<double> directions(n_proj*n_cols);
+    std::vector<double> offsets(n_proj);
+    for (std::size_t h=0; h < n_proj; ++h) {
+      for (std::size_t k=0; k < n_cols; ++k) {
+        directions[h*n_cols+k] = normal(rng);
+      }
+      offsets[h] = uniform(rng);
+    }
+    Clustering::logger(std::cout) << " LSH: " << n_tables << " tables of "
+                                  << n_hashes << " projections, bucket width " << w
+                                  << std::endl;
+    // bucket keys per table, format: [frame * n_tables + table]
+    std::vector<uint64_t> keys(n_tables*n_rows);
+    {
+      std::size_t i, t, h, k;
+      #pragma omp parallel for default(none) private(i,t,h,k)\
+        firstprivate(n_rows,n_cols,n_tables,n_hashes,w)\
+        shared(coords,directions,offsets,keys)
+      for (i=0; i < n_rows; ++i) {
+        for (t=0; t < n_tables; ++t) {
+          uint64_t key = t;
+          for (h=t*n_hashes; h < (t+1)*n_hashes; ++h) {
+            double proj = offsets[h];
+            for (k=0; k < n_cols; ++k) {
+              proj += directions[h*n_cols+k] * coords[i*n_cols+k];
+            }
+            key = mix(key, (int64_t) std::floor(proj / w));
+          }
+          keys[i*n_tables+t] = key;
+        }
+      }
+    }
+    // neighbor counts per frame (without the frame itself),
+    // format: [frame * n_radii + l]
+    std::vector<std::size_t> counts(n_rows*n_radii, 0);
+    std::vector<std::pair<uint64_t, std::size_t>> sorted_keys(n_rows);
+    std::vector<std::size_t> bucket_offsets;
+    for (std::size_t t=0; t < n_tables; ++t) {
+      for (std::size_t i=0; i < n_rows; ++i) {
+        sorted_keys[i] = {keys[i*n_tables+t], i};
+      }
+      std::sort(sorted_keys.begin(), sorted_keys.end());
+      bucket_offsets.clear();
+      for (std::size_t i=0; i < n_rows; ++i) {
+        if (i == 0 || sorted_keys[i].first != sorted_keys[i-1].first) {
+          bucket_offsets.push_back(i);
+        }
+      }
+      bucket_offsets.push_back(n_rows);
+      const std::size_t n_buckets = bucket_offsets.size() - 1;
+      // every frame is member of a single bucket per table,
+      // thus its counts are only updated by a single thread.
+      std::size_t i_bucket, a, b, i, j, q, l, n_cand, t_prev;
+      std::vector<std::size_t> candidates;
+      std::vector<float> dist2;
+      #pragma omp parallel for default(none)\
+        private(i_bucket,a,b,i,j,q,l,n_cand,t_prev)\
+        firstprivate(t,n_cols,n_radii,n_tables,n_buckets,rad2,candidates,dist2)\
+        shared(coords,keys,sorted_keys,bucket_offsets,counts)\
+        schedule(dynamic,64)
+      for (i_bucket=0; i_bucket < n_buckets; ++i_bucket) {
+        const std::size_t from = bucket_offsets[i_bucket];
+        const std::size_t to = bucket_offsets[i_bucket+1];
+        if (to - from < 2) {
+          continue;
+        }
+        if (candidates.size() < to - from) {
+          candidates.resize(to - from);
+          dist2.resize(to - from);
+        }
+        for (a=from; a < to; ++a) {
+          i = sorted_keys[a].second;
+          n_cand = 0;
+          for (b=from; b < to; ++b) {
+            j = sorted_keys[b].second;
+            if (i == j) {
+              continue;
+            }
+            // pairs sharing a bucket in a previous table are already counted
+            for (t_prev=0; t_prev < t; ++t_prev) {
+              if (keys[i*n_tables+t_prev] == keys[j*n_tables+t_prev]) {
+                break;
+              }
+            }
+            if (t_prev == t) {
+              candidates[n_cand] = j;
+              ++n_cand;
+            }
+          }
+          SIMD::squared_distances(&coords[i*n_cols]
+                                , coords
+                                , candidates.data()
+                                , n_cand
+                                , n_cols
+                                , dist2.data());
+          for (q=0; q < n_cand; ++q) {
+            for (l=0; l < n_radii; ++l) {
+              if (dist2[q] < rad2[l]) {
+                ++counts[i*n_radii+l];
+              } else {
+                // if it's not in the bigger radius,
+                // it won't be in the smaller ones.
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+    std::map<float, std::vector<std::size_t>> pops;
+    for (std::size_t l=0; l < n_radii; ++l) {
+      pops[radii[l]].resize(n_rows);
+      for (std::size_t i=0; i < n_rows; ++i) {
+        // every frame counts itself
+        pops[radii[l]][i] = counts[i*n_radii+l] + 1;
+      }
+    }
+    // approximate results must not go unnoticed:
+    // always report the estimated error.
+    if (params.n_samples > 0) {
+      for (auto err: estimate_errors(coords, n_rows, n_cols, pops, params.n_samples)) {
+        std::cout << "LSH populations for radius " << err.first
+                  << ": est. relative error " << err.second.mean_rel_error << " (mean), "
+                  << err.second.max_rel_error << " (max) on "
+                  << err.second.n_samples << " sampled frames" << std::endl;
+      }
+    }
+    return pops;
+  }
+
+  std::map<float, ErrorEstimate>
+  estimate_errors(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols,
+                  const std::map<float, std::vector<std::size_t>>& pops,
+                  const std::size_t n_samples) {
+    const std::size_t n = std::min(n_samples, n_rows);
+    // random samples (fixed seed) in ascending order
+    std::mt19937_64 rng(PROJECTION_SEED);
+    std::uniform_int_distribution<std::size_t> uniform(0, n_rows-1);
+    std::vector<std::size_t> samples(n);
+    for (std::size_t s=0; s < n; ++s) {
+      samples[s] = uniform(rng);
+    }
+    std::sort(samples.begin(), samples.end());
+    std::vector<float> radii;
+    for (auto& radius_pops: pops) {
+      radii.push_back(radius_pops.first);
+    }
+    std::sort(radii.begin(), radii.end(), std::greater<float>());
+    const std::size_t n_radii = radii.size();
+    std::vector<float> rad2(n_radii);
+    for (std::size_t l=0; l < n_radii; ++l) {
+      rad2[l] = radii[l]*radii[l];
+    }
+    // exact populations of sampled frames, format: [sample * n_radii + l]
+    std::vector<std::size_t> exact(n*n_radii, 1);
+    {
+      const std::size_t chunk_size = 1024;
+      std::size_t s, i, j_from, n_chunk, q, l;
+      std::vector<float> dist2(chunk_size);
+      #pragma omp parallel for default(none) private(s,i,j_from,n_chunk,q,l)\
+        firstprivate(n,n_rows,n_cols,n_radii,rad2,chunk_size,dist2)\
+        shared(coords,samples,exact)\
+        schedule(dynamic,1)
+      for (s=0; s < n; ++s) {
+        i = samples[s];
+        for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+          n_chunk = std::min(chunk_size, n_rows-j_from);
+          SIMD::squared_distances(&coords[i*n_cols]
+                                , &coords[j_from*n_cols]
+                                , n_chunk
+                                , n_cols
+                                , dist2.data());
+          for (q=0; q < n_chunk; ++q) {
+            if (j_from+q != i) {
+              for (l=0; l < n_radii; ++l) {
+                if (dist2[q] < rad2[l]) {
+                  ++exact[s*n_radii+l];
+                } else {
+                  break;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    std::map<float, ErrorEstimate> errors;
+    for (std::size_t l=0; l < n_radii; ++l) {
+      const std::vector<std::size_t>& approx = pops.find(radii[l])->second;
+      ErrorEstimate err = {n, 0.0, 0.0};
+      for (std::size_t s=0; s < n; ++s) {
+        double rel_error = std::abs((double) exact[s*n_radii+l] - (double) approx[samples[s]])
+                         / exact[s*n_radii+l];
+        err.mean_rel_error += rel_error;
+        err.max_rel_error = std::max(err.max_rel_error, rel_error);
+      }
+      if (n > 0) {
+        err.mean_rel_error /= n;
+      }
+      errors[radii[l]] = err;
+    }
+    return errors;
+  }
+
+} // end namespace LSH
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstddef>
+
+/*! \file
+ * approximate populations via locality-sensitive hashing (LSH).
+ *
+ * frames are hashed by p-stable (gaussian) random projections,
+ *
+ *   h(x) = floor((a*x + b) / w),
+ *
+ * into the buckets of several hash tables. frames close to each other
+ * are likely to share a bucket in at least one table. only frames sharing
+ * a bucket are compared (with exact distances), thus populations are
+ * never overestimated, but neighbors missed by all tables are not counted.
+ * the resulting error is estimated by exact population counts on a
+ * sample of frames.
+ */
+
+namespace Clustering {
+namespace Density {
+//! approximate population counts via locality-sensitive hashing
+namespace LSH {
+  //! parameters of the hash tables
+  struct Parameters {
+    //! number of hash tables, a pair is compared if it
+    //! shares a bucket in any table
+    std::size_t n_tables;
+    //! number of random projections combined per table
+    std::size_t n_hashes;
+    //! bucket width of projections, in units of the largest radius
+    float bucket_width;
+    //! number of sampled frames for error estimation
+    std::size_t n_samples;
+  };
+  //! default parameters: neighbors at the largest radius are
+  //! found with a probability of about 98%.
+  const Parameters DEFAULT_PARAMETERS = {8, 4, 4.0f, 1000};
+  //! estimated error of approximate populations for a single radius,
+  //! relative to the exact populations of sampled frames.
+  struct ErrorEstimate {
+    std::size_t n_samples;
+    double mean_rel_error;
+    double max_rel_error;
+  };
+  //! approximate populations for different radii.
+  //! the estimated error is printed for every radius.
+  std::map<float, std::vector<std::size_t>>
+  calculate_populations(const float* coords,
+                        const std::size_t n_rows,
+                        const std::size_t n_cols,
+                        const std::vector<float> radii,
+                        const Parameters& params = DEFAULT_PARAMETERS);
+  //! compare given populations to exact populations of 'n_samples'
+  //! randomly chosen frames.
+  std::map<float, ErrorEstimate>
+  estimate_errors(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols,
+                  const std::map<float, std::vector<std::size_t>>& pops,
+                  const std::size_t n_samples);
+} // end namespace LSH
+} // end namespace Density
+} // end namespace Clustering
+
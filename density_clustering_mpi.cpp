@@ -25,6 +25,8 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "density_clustering_mpi.hpp"
 #include "density_clustering_common.hpp"
+#include "density_clustering_simd.hpp"
+#include "density_clustering_pivots.hpp"
 
 #include "tools.hpp"
 #include "logger.hpp"
@@ -36,57 +38,29 @@ namespace Density {
 namespace MPI {
 
   namespace {
-    /*!
-     *
-     * use no. of rows and no. of MPI nodes to calculate the optimal
-     * indices for equal load balancing on all machines to
-     * calculate an upper triangular matrix by a nested loop
-     * of the form\n\n
-     *     FOR i=0 TO n_rows\n
-     * >      FOR j=i+1 TO n_rows\n
-     * >>        [...]
-     *
-     * the returned indices are for the initial index of the outer loop.
-     * the inner loop will be local.
-     * i.e. on every MPI node, the loop will be of the form\n\n
-     *     FOR i=indices[node_id] TO (is_last_node ? n_rows : indices[next_node])\n
-     * >      FOR j=i+1 TO n_rows\n
-     * >>        [...]
-     *
-     * computation of optimal indices is heavily based on triangular summation
-     * (please recall the 'algorithm of young C.F. Gauss').
-     */
-    std::vector<std::size_t>
-    triangular_load_balance(std::size_t n_rows,
-                            std::size_t n_nodes) {
-      auto young_gauss = [](std::size_t n) -> std::size_t {
-        return n*(n+1) / 2;
-      };
-      std::size_t workload = young_gauss(n_rows) / n_nodes;
-      std::size_t last_index = 0;
-      std::vector<std::size_t> load_balanced_indices(n_nodes);
-      for (int i=n_nodes-1; i >= 0; --i) {
-        if (i == 0) {
-          load_balanced_indices[i] = 0;
-        } else {
-          last_index = (std::size_t) sqrt(2*(young_gauss(last_index) + workload));
-          load_balanced_indices[i] = n_rows - last_index;
-        }
+    //! every node writes its tiles to its own checkpoint file
+    Tiles::Parameters
+    node_tiles(const Tiles::Parameters& tiles,
+               const int mpi_node_id) {
+      Tiles::Parameters params = tiles;
+      if ( ! params.filename.empty()) {
+        params.filename += Clustering::Tools::stringprintf(".%d", mpi_node_id);
       }
-      return load_balanced_indices;
+      return params;
     }
   } // end local namespace
 
-
   std::vector<std::size_t>
   calculate_populations(const float* coords,
                         const std::size_t n_rows,
                         const std::size_t n_cols,
                         const float radius,
                         const int mpi_n_nodes,
-                        const int mpi_node_id) {
+                        const int mpi_node_id,
+                        const std::size_t n_pivots,
+                        const Tiles::Parameters& tiles) {
     std::vector<float> radii = {radius};
-    std::map<float, std::vector<std::size_t>> pop_map = calculate_populations(coords, n_rows, n_cols, radii, mpi_n_nodes, mpi_node_id);
+    std::map<float, std::vector<std::size_t>> pop_map = calculate_populations(coords, n_rows, n_cols, radii, mpi_n_nodes, mpi_node_id, n_pivots, tiles);
     return pop_map[radius];
   }
 
@@ -97,19 +71,16 @@ namespace MPI {
                         const std::size_t n_cols,
                         std::vector<float> radii,
                         const int mpi_n_nodes,
-                        const int mpi_node_id) {
-    std::vector<std::size_t> load_balanced_indices = triangular_load_balance(n_rows, mpi_n_nodes);
-    unsigned int i_row_from = load_balanced_indices[mpi_node_id];
-    unsigned int i_row_to;
+                        const int mpi_node_id,
+                        const std::size_t n_pivots,
+                        const Tiles::Parameters& tiles) {
+    unsigned int rows_per_chunk = n_rows / mpi_n_nodes;
+    unsigned int i_row_from = mpi_node_id * rows_per_chunk;
+    unsigned int i_row_to = i_row_from + rows_per_chunk;
+    // last process has to do slightly more work
+    // in case of uneven separation of workload
     if (mpi_node_id == mpi_n_nodes-1) {
-      // last node: run to end
       i_row_to = n_rows;
-    } else {
-      i_row_to = load_balanced_indices[mpi_node_id+1];
-    }
-    std::map<float, std::vector<unsigned int>> pops;
-    for (float rad: radii) {
-      pops[rad].resize(n_rows, 1);
     }
     std::sort(radii.begin(), radii.end(), std::greater<float>());
     std::size_t n_radii = radii.size();
@@ -117,43 +88,133 @@ namespace MPI {
     for (std::size_t i=0; i < n_radii; ++i) {
       rad2[i] = radii[i]*radii[i];
     }
-
-//TODO: check: error with double counting?
-
-    // per-node parallel computation of pops using shared memory
+    // neighbor counts per radius index (without the frame itself).
+    // every node only fills its own rows, all other entries stay zero.
+    std::vector<std::vector<unsigned int>> pops(n_radii
+                                              , std::vector<unsigned int>(n_rows, 0));
+    // pivot distances of all frames, computed redundantly on every node.
+    Pivots::PivotTable pt;
+    if (n_pivots > 0) {
+      pt = Pivots::compute_pivot_table(coords, n_rows, n_cols, n_pivots);
+    }
+    const float pivot_accept_thr = (n_pivots > 0 ? Pivots::accept_threshold(pt, rad2[n_radii-1]) : 0.0f);
+    const float pivot_reject_thr = (n_pivots > 0 ? Pivots::reject_threshold(pt, rad2[0]) : 0.0f);
+    // per-node parallel computation of pops using shared memory.
+    // every frame's neighbors are counted by a single thread,
+    // so no atomic updates are needed.
     {
-      std::size_t i, j, k, l;
-      float dist, c;
+      // distances are computed in chunks of frames
+      const std::size_t chunk_size = 1024;
+      std::size_t i, j, j_from, n_chunk, n_exact, n_inside, l;
+      float dist;
+      std::vector<unsigned int> counts;
+      std::vector<std::size_t> chunk_frames(chunk_size);
+      std::vector<float> dist2(chunk_size);
+      std::vector<float> lower(chunk_size);
+      std::vector<float> upper(chunk_size);
       ASSUME_ALIGNED(coords);
-      #pragma omp parallel for default(none) private(i,j,k,l,c,dist) \
-                               firstprivate(i_row_from,i_row_to,n_rows,n_cols,rad2,radii,n_radii) \
-                               shared(coords,pops) \
-                               schedule(dynamic,1024)
-      for (i=i_row_from; i < i_row_to; ++i) {
-        for (j=i+1; j < n_rows; ++j) {
-          dist = 0.0f;
-          #pragma simd reduction(+:dist)
-          for (k=0; k < n_cols; ++k) {
-            c = coords[i*n_cols+k] - coords[j*n_cols+k];
-            dist += c*c;
-          }
+      // tiles of the node's rows, a single tile without checkpoints
+      const std::size_t n_node_rows = i_row_to - i_row_from;
+      const std::size_t tile_size = (tiles.filename.empty() ? std::max(n_node_rows, (std::size_t) 1) : tiles.tile_size);
+      const std::size_t n_tiles = (n_node_rows + tile_size - 1) / tile_size;
+      std::vector<std::size_t> n_tile_values(n_tiles);
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        n_tile_values[i_tile] = n_radii * (std::min(n_node_rows, (i_tile+1)*tile_size) - i_tile*tile_size);
+      }
+      uint64_t input_fingerprint = 0;
+      if ( ! tiles.filename.empty()) {
+        // the rows of a node depend on the number of nodes
+        const uint64_t tile_params[3] = {tile_size, (uint64_t) mpi_n_nodes, (uint64_t) mpi_node_id};
+        input_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float));
+        input_fingerprint = Tiles::fingerprint(radii.data(), n_radii*sizeof(float), input_fingerprint);
+        input_fingerprint = Tiles::fingerprint(tile_params, sizeof(tile_params), input_fingerprint);
+      }
+      Tiles::Checkpoint checkpoint = Tiles::open_checkpoint(node_tiles(tiles, mpi_node_id), "population", n_tile_values, input_fingerprint);
+      std::vector<uint64_t> tile_values;
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        const std::size_t i_from = i_row_from + i_tile*tile_size;
+        const std::size_t i_to = std::min((std::size_t) i_row_to, i_from+tile_size);
+        if (checkpoint.done[i_tile]) {
+          // format: [l * (i_to - i_from) + (i - i_from)]
+          const std::vector<uint64_t>& values = checkpoint.values[i_tile];
           for (l=0; l < n_radii; ++l) {
-            if (dist < rad2[l]) {
-              #pragma omp atomic
-              pops[radii[l]][i] += 1;
-              #pragma omp atomic
-              pops[radii[l]][j] += 1;
+            for (i=i_from; i < i_to; ++i) {
+              pops[l][i] = values[l*(i_to-i_from) + (i-i_from)];
+            }
+          }
+          continue;
+        }
+        #pragma omp parallel for default(none) private(i,j,j_from,n_chunk,n_exact,n_inside,l,dist) \
+                                 firstprivate(i_from,i_to,n_rows,n_cols,rad2,n_radii,n_pivots,pivot_accept_thr,pivot_reject_thr,counts,chunk_size,chunk_frames,dist2,lower,upper) \
+                                 shared(coords,pops,pt) \
+                                 schedule(dynamic,1024)
+        for (i=i_from; i < i_to; ++i) {
+          counts.assign(n_radii, 0);
+          n_inside = 0;
+          for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+            n_chunk = std::min(chunk_size, n_rows-j_from);
+            if (n_pivots > 0) {
+              // triangle inequality on pivot distances: skip pairs outside
+              // of the largest radius, count pairs inside of the smallest one.
+              Pivots::distance_bounds(pt, i, j_from, n_chunk, lower.data(), upper.data());
+              n_exact = 0;
+              for (j=j_from; j < j_from+n_chunk; ++j) {
+                if (i != j && lower[j-j_from] < pivot_reject_thr) {
+                  if (upper[j-j_from] < pivot_accept_thr) {
+                    ++n_inside;
+                  } else {
+                    chunk_frames[n_exact] = j;
+                    ++n_exact;
+                  }
+                }
+              }
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , coords
+                                    , chunk_frames.data()
+                                    , n_exact
+                                    , n_cols
+                                    , dist2.data());
             } else {
-              // if it's not in the bigger radius,
-              // it won't be in the smaller ones.
-              break;
+              n_exact = n_chunk;
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , &coords[j_from*n_cols]
+                                    , n_chunk
+                                    , n_cols
+                                    , dist2.data());
+            }
+            for (std::size_t q=0; q < n_exact; ++q) {
+              j = (n_pivots > 0 ? chunk_frames[q] : j_from+q);
+              if (i != j) {
+                dist = dist2[q];
+                for (l=0; l < n_radii; ++l) {
+                  if (dist < rad2[l]) {
+                    ++counts[l];
+                  } else {
+                    // if it's not in the bigger radius,
+                    // it won't be in the smaller ones.
+                    break;
+                  }
+                }
+              }
+            }
+          }
+          for (l=0; l < n_radii; ++l) {
+            pops[l][i] = counts[l] + n_inside;
+          }
+        }
+        if (checkpoint.enabled) {
+          tile_values.resize(n_radii*(i_to-i_from));
+          for (l=0; l < n_radii; ++l) {
+            for (i=i_from; i < i_to; ++i) {
+              tile_values[l*(i_to-i_from) + (i-i_from)] = pops[l][i];
             }
           }
+          Tiles::save_tile(checkpoint, i_tile, tile_values);
         }
       }
     }
     std::map<float, std::vector<std::size_t>> pops_results;
-    for (auto& rad_pops: pops) {
+    for (std::size_t l=0; l < n_radii; ++l) {
       // accumulate pops in main process and send result to slaves
       MPI_Barrier(MPI_COMM_WORLD);
       if (mpi_node_id == MAIN_PROCESS) {
@@ -162,21 +223,21 @@ namespace MPI {
           std::vector<unsigned int> pops_buf(n_rows);
           MPI_Recv(pops_buf.data(), n_rows, MPI_UNSIGNED, slave_id, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
           for (std::size_t i=0; i < n_rows; ++i) {
-            rad_pops.second[i] += pops_buf[i];
+            pops[l][i] += pops_buf[i];
           }
         }
       } else {
         // send pops from slaves
-        MPI_Send(rad_pops.second.data(), n_rows, MPI_UNSIGNED, MAIN_PROCESS, 0, MPI_COMM_WORLD);
+        MPI_Send(pops[l].data(), n_rows, MPI_UNSIGNED, MAIN_PROCESS, 0, MPI_COMM_WORLD);
       }
       MPI_Barrier(MPI_COMM_WORLD);
       // broadcast accumulated pops to slaves
-      MPI_Bcast(rad_pops.second.data(), n_rows, MPI_UNSIGNED, MAIN_PROCESS, MPI_COMM_WORLD);
+      MPI_Bcast(pops[l].data(), n_rows, MPI_UNSIGNED, MAIN_PROCESS, MPI_COMM_WORLD);
       MPI_Barrier(MPI_COMM_WORLD);
       // cast unsigned int to size_t and add 1 for own structure
-      pops_results[rad_pops.first].resize(n_rows);
+      pops_results[radii[l]].resize(n_rows);
       for (std::size_t i=0; i < n_rows; ++i) {
-        pops_results[rad_pops.first][i] = (std::size_t) rad_pops.second[i] + 1;
+        pops_results[radii[l]][i] = (std::size_t) pops[l][i] + 1;
       }
     }
     return pops_results;
@@ -189,7 +250,9 @@ namespace MPI {
                     const std::size_t n_cols,
                     const std::vector<float>& free_energy,
                     const int mpi_n_nodes,
-                    const int mpi_node_id) {
+                    const int mpi_node_id,
+                    const std::size_t n_pivots,
+                    const Tiles::Parameters& tiles) {
     unsigned int rows_per_chunk = n_rows / mpi_n_nodes;
     unsigned int i_row_from = mpi_node_id * rows_per_chunk;
     unsigned int i_row_to = i_row_from + rows_per_chunk;
@@ -198,98 +261,161 @@ namespace MPI {
     if (mpi_node_id == mpi_n_nodes-1 ) {
       i_row_to = n_rows;
     }
-    Neighborhood nh;
-    Neighborhood nh_high_dens;
     // initialize neighborhood
-    for (std::size_t i=i_row_from; i < i_row_to; ++i) {
-      nh[i] = Neighbor(n_rows+1, std::numeric_limits<float>::max());
-      nh_high_dens[i] = Neighbor(n_rows+1, std::numeric_limits<float>::max());
+    Neighborhood nh(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    Neighborhood nh_high_dens(n_rows, n_rows+1, std::numeric_limits<float>::max());
+    Pivots::PivotTable pt;
+    if (n_pivots > 0) {
+      pt = Pivots::compute_pivot_table(coords, n_rows, n_cols, n_pivots);
     }
     // calculate nearest neighbors with distances
     {
-      std::size_t i, j, c, min_j, min_j_high_dens;
-      float dist, d, mindist, mindist_high_dens;
+      // distances are computed in chunks of frames
+      const std::size_t chunk_size = 1024;
+      std::size_t i, j, j_from, n_chunk, n_exact, min_j, min_j_high_dens;
+      float dist, mindist, mindist_high_dens, reject_thr, reject_thr_high_dens;
+      std::vector<std::size_t> chunk_frames(chunk_size);
+      std::vector<float> dist2(chunk_size);
+      std::vector<float> lower(chunk_size);
+      std::vector<float> upper(chunk_size);
       ASSUME_ALIGNED(coords);
-      #pragma omp parallel for default(none) \
-                               private(i,j,c,dist,d,mindist,mindist_high_dens,min_j,min_j_high_dens) \
-                               firstprivate(i_row_from,i_row_to,n_rows,n_cols) \
-                               shared(coords,nh,nh_high_dens,free_energy) \
-                               schedule(dynamic, 2048)
-      for (i=i_row_from; i < i_row_to; ++i) {
-        mindist = std::numeric_limits<float>::max();
-        mindist_high_dens = std::numeric_limits<float>::max();
-        min_j = n_rows+1;
-        min_j_high_dens = n_rows+1;
-        for (j=0; j < n_rows; ++j) {
-          if (i != j) {
-            dist = 0.0f;
-            #pragma simd reduction(+:dist)
-            for (c=0; c < n_cols; ++c) {
-              d = coords[i*n_cols+c] - coords[j*n_cols+c];
-              dist += d*d;
-            }
-            // direct neighbor
-            if (dist < mindist) {
-              mindist = dist;
-              min_j = j;
+      // tiles of the node's rows, a single tile without checkpoints
+      const std::size_t n_node_rows = i_row_to - i_row_from;
+      const std::size_t tile_size = (tiles.filename.empty() ? std::max(n_node_rows, (std::size_t) 1) : tiles.tile_size);
+      const std::size_t n_tiles = (n_node_rows + tile_size - 1) / tile_size;
+      // 4 values per frame, see below
+      std::vector<std::size_t> n_tile_values(n_tiles);
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        n_tile_values[i_tile] = 4 * (std::min(n_node_rows, (i_tile+1)*tile_size) - i_tile*tile_size);
+      }
+      uint64_t input_fingerprint = 0;
+      if ( ! tiles.filename.empty()) {
+        // the rows of a node depend on the number of nodes
+        const uint64_t tile_params[3] = {tile_size, (uint64_t) mpi_n_nodes, (uint64_t) mpi_node_id};
+        input_fingerprint = Tiles::fingerprint(coords, n_rows*n_cols*sizeof(float));
+        input_fingerprint = Tiles::fingerprint(free_energy.data(), n_rows*sizeof(float), input_fingerprint);
+        input_fingerprint = Tiles::fingerprint(tile_params, sizeof(tile_params), input_fingerprint);
+      }
+      Tiles::Checkpoint checkpoint = Tiles::open_checkpoint(node_tiles(tiles, mpi_node_id), "nearest neighbor", n_tile_values, input_fingerprint);
+      std::vector<uint64_t> tile_values;
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        const std::size_t i_from = i_row_from + i_tile*tile_size;
+        const std::size_t i_to = std::min((std::size_t) i_row_to, i_from+tile_size);
+        if (checkpoint.done[i_tile]) {
+          // format: [(i - i_from) * 4 + {id, dist2, id high dens, dist2 high dens}]
+          const std::vector<uint64_t>& values = checkpoint.values[i_tile];
+          for (i=i_from; i < i_to; ++i) {
+            nh.set(i, values[4*(i-i_from)], Tiles::value_float(values[4*(i-i_from)+1]));
+            nh_high_dens.set(i, values[4*(i-i_from)+2], Tiles::value_float(values[4*(i-i_from)+3]));
+          }
+          continue;
+        }
+        #pragma omp parallel for default(none) \
+                                 private(i,j,j_from,n_chunk,n_exact,dist,mindist,mindist_high_dens,min_j,min_j_high_dens,reject_thr,reject_thr_high_dens) \
+                                 firstprivate(i_from,i_to,n_rows,n_cols,n_pivots,chunk_size,chunk_frames,dist2,lower,upper) \
+                                 shared(coords,pt,nh,nh_high_dens,free_energy) \
+                                 schedule(dynamic, 2048)
+        for (i=i_from; i < i_to; ++i) {
+          mindist = std::numeric_limits<float>::max();
+          mindist_high_dens = std::numeric_limits<float>::max();
+          min_j = n_rows+1;
+          min_j_high_dens = n_rows+1;
+          for (j_from=0; j_from < n_rows; j_from += chunk_size) {
+            n_chunk = std::min(chunk_size, n_rows-j_from);
+            if (n_pivots > 0) {
+              // skip frames that cannot be closer than the current
+              // neighbors (the minima only decrease inside the chunk).
+              Pivots::distance_bounds(pt, i, j_from, n_chunk, lower.data(), upper.data());
+              reject_thr = Pivots::reject_threshold(pt, mindist);
+              reject_thr_high_dens = Pivots::reject_threshold(pt, mindist_high_dens);
+              n_exact = 0;
+              for (j=j_from; j < j_from+n_chunk; ++j) {
+                if (lower[j-j_from] < reject_thr
+                 || (free_energy[j] < free_energy[i]
+                  && lower[j-j_from] < reject_thr_high_dens)) {
+                  chunk_frames[n_exact] = j;
+                  ++n_exact;
+                }
+              }
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , coords
+                                    , chunk_frames.data()
+                                    , n_exact
+                                    , n_cols
+                                    , dist2.data());
+            } else {
+              n_exact = n_chunk;
+              SIMD::squared_distances(&coords[i*n_cols]
+                                    , &coords[j_from*n_cols]
+                                    , n_chunk
+                                    , n_cols
+                                    , dist2.data());
             }
-            // next neighbor with higher density / lower free energy
-            if (free_energy[j] < free_energy[i] && dist < mindist_high_dens) {
-              mindist_high_dens = dist;
-              min_j_high_dens = j;
+            // frames in ascending order, as in exhaustive search
+            for (std::size_t q=0; q < n_exact; ++q) {
+              j = (n_pivots > 0 ? chunk_frames[q] : j_from+q);
+              if (i != j) {
+                dist = dist2[q];
+                // direct neighbor
+                if (dist < mindist) {
+                  mindist = dist;
+                  min_j = j;
+                }
+                // next neighbor with higher density / lower free energy
+                if (free_energy[j] < free_energy[i] && dist < mindist_high_dens) {
+                  mindist_high_dens = dist;
+                  min_j_high_dens = j;
+                }
+              }
             }
           }
+          nh.set(i, min_j, mindist);
+          nh_high_dens.set(i, min_j_high_dens, mindist_high_dens);
+        }
+        if (checkpoint.enabled) {
+          tile_values.resize(4*(i_to-i_from));
+          for (i=i_from; i < i_to; ++i) {
+            tile_values[4*(i-i_from)] = nh.ids[i];
+            tile_values[4*(i-i_from)+1] = Tiles::float_value(nh.dist2[i]);
+            tile_values[4*(i-i_from)+2] = nh_high_dens.ids[i];
+            tile_values[4*(i-i_from)+3] = Tiles::float_value(nh_high_dens.dist2[i]);
+          }
+          Tiles::save_tile(checkpoint, i_tile, tile_values);
         }
-        nh[i] = Neighbor(min_j, mindist);
-        nh_high_dens[i] = Neighbor(min_j_high_dens, mindist_high_dens);
       }
     }
-    // collect results in MAIN_PROCESS
+    // collect results in MAIN_PROCESS,
+    // i.e. the row chunks of all neighborhood tables
     MPI_Barrier(MPI_COMM_WORLD);
-    {
-      // buf: I_FROM, I_TO_NH, DIST, I_TO_NH_HD, DIST_HD
-      int BUF_SIZE = 5;
-      float buf[BUF_SIZE];
-      if (mpi_node_id == MAIN_PROCESS) {
-        while (nh.size() != n_rows) {
-          MPI_Recv(buf, BUF_SIZE, MPI_FLOAT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-          nh[(int) buf[0]] = Neighbor((int) buf[1], buf[2]);
-          nh_high_dens[(int) buf[0]] = Neighbor((int) buf[3], buf[4]);
+    if (mpi_node_id == MAIN_PROCESS) {
+      for (int node=0; node < mpi_n_nodes; ++node) {
+        if (node == MAIN_PROCESS) {
+          continue;
         }
-      } else {
-        for (std::size_t i=i_row_from; i < i_row_to; ++i) {
-          buf[0] = (float) i;
-          buf[1] = (float) nh[i].first;
-          buf[2] = nh[i].second;
-          buf[3] = nh_high_dens[i].first;
-          buf[4] = nh_high_dens[i].second;
-          MPI_Send(buf, BUF_SIZE, MPI_FLOAT, MAIN_PROCESS, 0, MPI_COMM_WORLD);
+        unsigned int node_row_from = node * rows_per_chunk;
+        unsigned int node_row_to = node_row_from + rows_per_chunk;
+        if (node == mpi_n_nodes-1) {
+          node_row_to = n_rows;
         }
+        int n_chunk_rows = node_row_to - node_row_from;
+        MPI_Recv(&nh.ids[node_row_from], n_chunk_rows, MPI_UINT32_T, node, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(&nh.dist2[node_row_from], n_chunk_rows, MPI_FLOAT, node, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(&nh_high_dens.ids[node_row_from], n_chunk_rows, MPI_UINT32_T, node, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(&nh_high_dens.dist2[node_row_from], n_chunk_rows, MPI_FLOAT, node, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       }
+    } else {
+      int n_chunk_rows = i_row_to - i_row_from;
+      MPI_Send(&nh.ids[i_row_from], n_chunk_rows, MPI_UINT32_T, MAIN_PROCESS, 0, MPI_COMM_WORLD);
+      MPI_Send(&nh.dist2[i_row_from], n_chunk_rows, MPI_FLOAT, MAIN_PROCESS, 1, MPI_COMM_WORLD);
+      MPI_Send(&nh_high_dens.ids[i_row_from], n_chunk_rows, MPI_UINT32_T, MAIN_PROCESS, 2, MPI_COMM_WORLD);
+      MPI_Send(&nh_high_dens.dist2[i_row_from], n_chunk_rows, MPI_FLOAT, MAIN_PROCESS, 3, MPI_COMM_WORLD);
     }
     // broadcast result to slaves
     MPI_Barrier(MPI_COMM_WORLD);
-    {
-      // buf: n_rows X {I_FROM, I_TO_NH, DIST, I_TO_NH_HD, DIST_HD}
-      int BUF_SIZE = 4*n_rows;
-      std::vector<float> buf(BUF_SIZE);
-      if (mpi_node_id == MAIN_PROCESS) {
-        for (std::size_t i=0; i < n_rows; ++i) {
-          buf[4*i] = (float) nh[i].first;
-          buf[4*i+1] = nh[i].second;
-          buf[4*i+2] = (float) nh_high_dens[i].first;
-          buf[4*i+3] = nh_high_dens[i].second;
-        }
-      }
-      MPI_Bcast(buf.data(), BUF_SIZE, MPI_FLOAT, MAIN_PROCESS, MPI_COMM_WORLD);
-      if (mpi_node_id != MAIN_PROCESS) {
-        // unpack broadcasted neighborhood data
-        for (std::size_t i=0; i < n_rows; ++i) {
-          nh[i] = Neighbor((int) buf[4*i], buf[4*i+1]);
-          nh_high_dens[i] = Neighbor((int) buf[4*i+2], buf[4*i+3]);
-        }
-      }
-    }
+    MPI_Bcast(nh.ids.data(), n_rows, MPI_UINT32_T, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Bcast(nh.dist2.data(), n_rows, MPI_FLOAT, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Bcast(nh_high_dens.ids.data(), n_rows, MPI_UINT32_T, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Bcast(nh_high_dens.dist2.data(), n_rows, MPI_FLOAT, MAIN_PROCESS, MPI_COMM_WORLD);
     return std::make_tuple(nh, nh_high_dens);
   }
 
@@ -316,23 +442,30 @@ namespace MPI {
       // buffer to hold information whether frame i is
       // in neighborhood (-> assign 1) or not (-> keep 0)
       std::vector<int> frame_in_nh(limit, 0);
-      std::size_t j,c;
-      const std::size_t i_frame_sorted = sorted_fe[i_frame].first * n_cols;
-      float d,dist2;
+      // distances are computed in chunks of frames
+      const std::size_t chunk_size = 256;
+      std::size_t j,j_from,n_chunk;
+      const float* ref = &coords[sorted_fe[i_frame].first * n_cols];
+      std::vector<std::size_t> chunk_frames(chunk_size);
+      std::vector<float> dist2(chunk_size);
       ASSUME_ALIGNED(coords);
-      #pragma omp parallel for default(none) private(j,c,d,dist2) \
-                               firstprivate(i_frame,i_frame_sorted,i_row_from,i_row_to,max_dist,n_cols) \
+      #pragma omp parallel for default(none) private(j,j_from,n_chunk) \
+                               firstprivate(i_frame,ref,i_row_from,i_row_to,max_dist,n_cols,chunk_size,chunk_frames,dist2) \
                                shared(coords,sorted_fe,frame_in_nh)
-      for (j=i_row_from; j < i_row_to; ++j) {
-        if (i_frame != j) {
-          dist2 = 0.0f;
-          #pragma simd reduction(+:dist2)
-          for (c=0; c < n_cols; ++c) {
-            d = coords[i_frame_sorted+c] - coords[sorted_fe[j].first*n_cols+c];
-            dist2 += d*d;
-          }
-          if (dist2 < max_dist) {
-            frame_in_nh[j] = 1;
+      for (j_from=i_row_from; j_from < i_row_to; j_from += chunk_size) {
+        n_chunk = std::min(chunk_size, i_row_to-j_from);
+        for (j=0; j < n_chunk; ++j) {
+          chunk_frames[j] = sorted_fe[j_from+j].first;
+        }
+        SIMD::squared_distances(ref
+                              , coords
+                              , chunk_frames.data()
+                              , n_chunk
+                              , n_cols
+                              , dist2.data());
+        for (j=0; j < n_chunk; ++j) {
+          if (i_frame != j_from+j && dist2[j] < max_dist) {
+            frame_in_nh[j_from+j] = 1;
           }
         }
       }
@@ -407,13 +540,65 @@ namespace MPI {
       Clustering::logger(std::cout) << "reading coords" << std::endl;
     }
     std::tie(coords, n_rows, n_cols) = Clustering::Tools::read_coords<float>(input_file);
+    SIMD::select_instruction_set(args["simd"].as<std::string>());
+    if (args["pivots"].as<int>() < 0) {
+      if (node_id == MAIN_PROCESS) {
+        std::cerr << "error: number of pivots (--pivots) must not be negative." << std::endl;
+      }
+      exit(EXIT_FAILURE);
+    }
+    const std::size_t n_pivots = args["pivots"].as<int>();
+    //// tile checkpoints of population and nearest neighbor computations,
+    //// one checkpoint file per node
+    Tiles::Parameters pop_tiles = Tiles::DEFAULT_PARAMETERS;
+    Tiles::Parameters nn_tiles = Tiles::DEFAULT_PARAMETERS;
+    if (args.count("tile-checkpoint")) {
+      if (args["tile-size"].as<int>() < 1) {
+        if (node_id == MAIN_PROCESS) {
+          std::cerr << "error: tiles need at least one frame (--tile-size)." << std::endl;
+        }
+        exit(EXIT_FAILURE);
+      }
+      const std::string basename = args["tile-checkpoint"].as<std::string>();
+      pop_tiles.tile_size = nn_tiles.tile_size = args["tile-size"].as<int>();
+      pop_tiles.resume = nn_tiles.resume = args["tile-resume"].as<bool>();
+      pop_tiles.filename = basename + ".pop";
+      nn_tiles.filename = basename + ".nn";
+    }
+    //// space-filling curve reordering:
+    //// all computations run on reordered frames,
+    //// while inputs and outputs are kept in original frame order.
+    std::vector<std::size_t> order;
+    const std::string curve = args["reorder"].as<std::string>();
+    if (curve != "none") {
+      if (args["reorder-dims"].as<int>() < 1) {
+        if (node_id == MAIN_PROCESS) {
+          std::cerr << "error: space-filling curve needs at least one dimension (--reorder-dims)." << std::endl;
+        }
+        exit(EXIT_FAILURE);
+      }
+      if (args["reorder-dims"].as<int>() > (int) MAX_CURVE_DIMS) {
+        if (node_id == MAIN_PROCESS) {
+          std::cerr << "error: space-filling curve spans at most " << MAX_CURVE_DIMS
+                    << " dimensions (--reorder-dims)." << std::endl;
+        }
+        exit(EXIT_FAILURE);
+      }
+      if (node_id == MAIN_PROCESS) {
+        Clustering::logger(std::cout) << "reordering frames along " << curve << " curve" << std::endl;
+      }
+      order = space_filling_curve_order(coords, n_rows, n_cols, curve, args["reorder-dims"].as<int>());
+      float* curve_coords = Clustering::Tools::reordered_coords(coords, n_rows, n_cols, order);
+      Clustering::Tools::free_coords(coords);
+      coords = curve_coords;
+    }
     //// free energies
     std::vector<float> free_energies;
     if (args.count("free-energy-input")) {
       if (node_id == MAIN_PROCESS) {
         Clustering::logger(std::cout) << "re-using free energy data." << std::endl;
       }
-      free_energies = Clustering::Tools::read_free_energies(args["free-energy-input"].as<std::string>());
+      free_energies = Clustering::Tools::reordered(Clustering::Tools::read_free_energies(args["free-energy-input"].as<std::string>()), order);
     } else if (args.count("free-energy") || args.count("population") || args.count("output")) {
       if (args.count("radii")) {
         // compute populations & free energies for different radii in one go
@@ -424,13 +609,15 @@ namespace MPI {
           exit(EXIT_FAILURE);
         }
         std::vector<float> radii = args["radii"].as<std::vector<float>>();
-        std::map<float, std::vector<std::size_t>> pops = calculate_populations(coords, n_rows, n_cols, radii, n_nodes, node_id);
+        std::map<float, std::vector<std::size_t>> pops = calculate_populations(coords, n_rows, n_cols, radii, n_nodes, node_id, n_pivots, pop_tiles);
         if (node_id == MAIN_PROCESS) {
           for (auto radius_pops: pops) {
             std::string basename_pop = args["population"].as<std::string>() + "_%f";
             std::string basename_fe = args["free-energy"].as<std::string>() + "_%f";
-            Clustering::Tools::write_pops(Clustering::Tools::stringprintf(basename_pop, radius_pops.first), radius_pops.second);
-            Clustering::Tools::write_fes(Clustering::Tools::stringprintf(basename_fe, radius_pops.first), calculate_free_energies(radius_pops.second));
+            Clustering::Tools::write_pops(Clustering::Tools::stringprintf(basename_pop, radius_pops.first)
+                                        , Clustering::Tools::original_order(radius_pops.second, order));
+            Clustering::Tools::write_fes(Clustering::Tools::stringprintf(basename_fe, radius_pops.first)
+                                       , Clustering::Tools::original_order(calculate_free_energies(radius_pops.second), order));
           }
         }
       } else {
@@ -441,16 +628,19 @@ namespace MPI {
         if (node_id == MAIN_PROCESS) {
           Clustering::logger(std::cout) << "calculating populations" << std::endl;
         }
-        std::vector<std::size_t> pops = calculate_populations(coords, n_rows, n_cols, radius, n_nodes, node_id);
+        std::vector<std::size_t> pops = calculate_populations(coords, n_rows, n_cols, radius, n_nodes, node_id, n_pivots, pop_tiles);
         if (node_id == MAIN_PROCESS && args.count("population")) {
-          Clustering::Tools::write_single_column<std::size_t>(args["population"].as<std::string>(), pops);
+          Clustering::Tools::write_single_column<std::size_t>(args["population"].as<std::string>()
+                                                            , Clustering::Tools::original_order(pops, order));
         }
         if (node_id == MAIN_PROCESS) {
           Clustering::logger(std::cout) << "calculating free energies" << std::endl;
         }
         free_energies = Clustering::Density::calculate_free_energies(pops);
         if (node_id == MAIN_PROCESS && args.count("free-energy")) {
-          Clustering::Tools::write_single_column<float>(args["free-energy"].as<std::string>(), free_energies, true);
+          Clustering::Tools::write_single_column<float>(args["free-energy"].as<std::string>()
+                                                      , Clustering::Tools::original_order(free_energies, order)
+                                                      , true);
         }
       }
     }
@@ -460,15 +650,17 @@ namespace MPI {
     if (args.count("nearest-neighbors-input")) {
       Clustering::logger(std::cout) << "re-using nearest neighbor data." << std::endl;
       auto nh_pair = Clustering::Tools::read_neighborhood(args["nearest-neighbors-input"].as<std::string>());
-      nh = nh_pair.first;
-      nh_high_dens = nh_pair.second;
+      nh = Clustering::Tools::reordered(nh_pair.first, order);
+      nh_high_dens = Clustering::Tools::reordered(nh_pair.second, order);
     } else if (args.count("nearest-neighbors") || args.count("output")) {
       Clustering::logger(std::cout) << "calculating nearest neighbors" << std::endl;
-      auto nh_tuple = nearest_neighbors(coords, n_rows, n_cols, free_energies, n_nodes, node_id);
+      auto nh_tuple = nearest_neighbors(coords, n_rows, n_cols, free_energies, n_nodes, node_id, n_pivots, nn_tiles);
       nh = std::get<0>(nh_tuple);
       nh_high_dens = std::get<1>(nh_tuple);
       if (node_id == MAIN_PROCESS && args.count("nearest-neighbors")) {
-        Clustering::Tools::write_neighborhood(args["nearest-neighbors"].as<std::string>(), nh, nh_high_dens);
+        Clustering::Tools::write_neighborhood(args["nearest-neighbors"].as<std::string>()
+                                            , Clustering::Tools::original_order(nh, order)
+                                            , Clustering::Tools::original_order(nh_high_dens, order));
       }
     }
     //// clustering
@@ -477,7 +669,7 @@ namespace MPI {
       std::vector<std::size_t> clustering;
       if (args.count("input")) {
         Clustering::logger(std::cout) << "reading initial clusters from file." << std::endl;
-        clustering = Clustering::Tools::read_clustered_trajectory(args["input"].as<std::string>());
+        clustering = Clustering::Tools::reordered(Clustering::Tools::read_clustered_trajectory(args["input"].as<std::string>()), order);
       } else {
         Clustering::logger(std::cout) << "calculating initial clusters" << std::endl;
         if (args.count("threshold") == 0) {
@@ -490,10 +682,10 @@ namespace MPI {
       if (node_id == MAIN_PROCESS) {
         if ( ! args["only-initial"].as<bool>()) {
           Clustering::logger(std::cout) << "assigning low density states to initial clusters" << std::endl;
-          clustering = Clustering::Density::assign_low_density_frames(clustering, nh_high_dens, free_energies);
+          clustering = Clustering::Density::assign_low_density_frames(clustering, nh_high_dens, free_energies, order);
         }
         Clustering::logger(std::cout) << "writing clusters to file " << output_file << std::endl;
-        Clustering::Tools::write_single_column<std::size_t>(output_file, clustering);
+        Clustering::Tools::write_single_column<std::size_t>(output_file, Clustering::Tools::original_order(clustering, order));
       }
     }
     // clean up
@@ -45,25 +45,39 @@ namespace MPI {
                         const std::size_t n_cols,
                         const float radius,
                         const int mpi_n_nodes,
-                        const int mpi_node_id);
+                        const int mpi_node_id,
+                        const std::size_t n_pivots = 0,
+                        const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS);
   //! MPI implementation of
   //! \link Clustering::Density::calculate_populations(const float* coords, const std::size_t n_rows, const std::size_t n_cols, const std::vector<float> radii)
+  //! with 'n_pivots' > 0, pairs are pruned by the triangle inequality
+  //! on pivot distances (see Clustering::Density::Pivots).
+  //! with a checkpoint file, every node processes its rows in tiles and
+  //! saves them to its own file (with the node id appended to the filename).
   std::map<float, std::vector<std::size_t>>
   calculate_populations(const float* coords,
                         const std::size_t n_rows,
                         const std::size_t n_cols,
                         std::vector<float> radii,
                         const int mpi_n_nodes,
-                        const int mpi_node_id);
+                        const int mpi_node_id,
+                        const std::size_t n_pivots = 0,
+                        const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS);
   //! MPI implementation of
   //! \link Clustering::Density::nearest_neighbors
+  //! with 'n_pivots' > 0, pairs are pruned by the triangle inequality
+  //! on pivot distances (see Clustering::Density::Pivots).
+  //! with a checkpoint file, every node processes its rows in tiles and
+  //! saves them to its own file (with the node id appended to the filename).
   std::tuple<Neighborhood, Neighborhood>
   nearest_neighbors(const float* coords,
                     const std::size_t n_rows,
                     const std::size_t n_cols,
                     const std::vector<float>& free_energy,
                     const int mpi_n_nodes,
-                    const int mpi_node_id);
+                    const int mpi_node_id,
+                    const std::size_t n_pivots = 0,
+                    const Tiles::Parameters& tiles = Tiles::DEFAULT_PARAMETERS);
   //! MPI implementation of
   //! \link Clustering::Density::high_density_neighborhood
   std::set<std::size_t>
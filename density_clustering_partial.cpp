@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_partial.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace Clustering {
+namespace Density {
+namespace PartialDistances {
+
+  namespace {
+    /*!
+     * partial squared distance of ordered frames 'x' and 'y'.
+     * every column of a chunk is accumulated in its own lane (vectorized
+     * without re-association), the lanes are summed up after every chunk.
+     * the sum of the lanes never decreases from one chunk to the next.
+     * 'n_evaluated' is set to the number of summed up (padded) columns.
+     */
+    inline float
+    partial_distance(const float* x,
+                     const float* y,
+                     const std::size_t n_padded_cols,
+                     const float reject_thr,
+                     std::size_t& n_evaluated) {
+      float lanes[CHUNK_SIZE] = {0.0f};
+      float dist2 = 0.0f;
+      std::size_t k = 0;
+      while (k < n_padded_cols) {
+        for (std::size_t m=0; m < CHUNK_SIZE; ++m) {
+          float c = x[k+m] - y[k+m];
+          lanes[m] += c*c;
+        }
+        k += CHUNK_SIZE;
+        dist2 = 0.0f;
+        for (std::size_t m=0; m < CHUNK_SIZE; ++m) {
+          dist2 += lanes[m];
+        }
+        if (dist2 >= reject_thr) {
+          break;
+        }
+      }
+      n_evaluated = k;
+      return dist2;
+    }
+
+    template <typename THRESHOLD>
+    std::size_t
+    partial_squared_distances(const OrderedCoords& oc,
+                              const std::size_t i,
+                              const std::size_t* frames,
+                              const std::size_t n_frames,
+                              THRESHOLD reject_thr,
+                              float* partial_dist2) {
+      const std::size_t n_padded_cols = oc.n_padded_cols;
+      const float* ref = &oc.coords[i*n_padded_cols];
+      std::size_t n_evaluated = 0;
+      std::size_t n_frame_evaluated;
+      for (std::size_t j=0; j < n_frames; ++j) {
+        partial_dist2[j] = partial_distance(ref
+                                          , &oc.coords[frames[j]*n_padded_cols]
+                                          , n_padded_cols
+                                          , reject_thr(j)
+                                          , n_frame_evaluated);
+        // padding columns do not count as evaluated
+        n_evaluated += std::min(n_frame_evaluated, oc.n_cols);
+      }
+      return n_evaluated;
+    }
+  } // end local namespace
+
+  OrderedCoords
+  variance_ordered_coords(const float* coords,
+                          const std::size_t n_rows,
+                          const std::size_t n_cols) {
+    OrderedCoords oc;
+    oc.n_rows = n_rows;
+    oc.n_cols = n_cols;
+    oc.n_padded_cols = ((n_cols + CHUNK_SIZE - 1) / CHUNK_SIZE) * CHUNK_SIZE;
+    // rounding errors of the squared distances grow linearly with
+    // the number of summed up dimensions
+    oc.tolerance = 4.0 * (oc.n_padded_cols + 4) * std::numeric_limits<float>::epsilon();
+    std::vector<double> variance(n_cols);
+    for (std::size_t k=0; k < n_cols; ++k) {
+      double sum = 0.0;
+      double sum2 = 0.0;
+      for (std::size_t i=0; i < n_rows; ++i) {
+        double x = coords[i*n_cols+k];
+        sum += x;
+        sum2 += x*x;
+      }
+      variance[k] = (n_rows == 0) ? 0.0 : (sum2 - sum*sum/n_rows) / n_rows;
+    }
+    oc.col_order.resize(n_cols);
+    std::iota(oc.col_order.begin(), oc.col_order.end(), 0);
+    std::stable_sort(oc.col_order.begin()
+                   , oc.col_order.end()
+                   , [&](std::size_t k1, std::size_t k2) -> bool {
+                       return variance[k1] > variance[k2];
+                     });
+    oc.coords.assign(n_rows*oc.n_padded_cols, 0.0f);
+    for (std::size_t i=0; i < n_rows; ++i) {
+      for (std::size_t k=0; k < n_cols; ++k) {
+        oc.coords[i*oc.n_padded_cols+k] = coords[i*n_cols+oc.col_order[k]];
+      }
+    }
+    return oc;
+  }
+
+  std::size_t
+  partial_squared_distances(const OrderedCoords& oc,
+                            const std::size_t i,
+                            const std::size_t* frames,
+                            const std::size_t n_frames,
+                            const float reject_thr,
+                            float* partial_dist2) {
+    return partial_squared_distances(oc
+                                   , i
+                                   , frames
+                                   , n_frames
+                                   , [reject_thr](std::size_t) -> float {
+                                       return reject_thr;
+                                     }
+                                   , partial_dist2);
+  }
+
+  std::size_t
+  partial_squared_distances(const OrderedCoords& oc,
+                            const std::size_t i,
+                            const std::size_t* frames,
+                            const std::size_t n_frames,
+                            const float* reject_thr,
+                            float* partial_dist2) {
+    return partial_squared_distances(oc
+                                   , i
+                                   , frames
+                                   , n_frames
+                                   , [reject_thr](std::size_t j) -> float {
+                                       return reject_thr[j];
+                                     }
+                                   , partial_dist2);
+  }
+
+  float
+  reject_threshold(const OrderedCoords& oc,
+                   const float rad2) {
+    double r = rad2 * (1.0 + oc.tolerance);
+    if (r > std::numeric_limits<float>::max()) {
+      return std::numeric_limits<float>::infinity();
+    }
+    return (float) r;
+  }
+
+} // end namespace PartialDistances
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/*! \file
+ * partial distances with early abandonment.
+ *
+ * columns are re-ordered by decreasing variance and every squared distance
+ * is summed up in chunks of columns. after every chunk, the partial sum is
+ * compared against a rejection threshold (e.g. the largest radius or the
+ * current nearest neighbor distance) and the summation is stopped as soon
+ * as it is reached. for PCA-like input, most of the distance is covered
+ * by the first few columns and the trailing columns are rarely evaluated.
+ * partial sums never decrease, thus rejected pairs are definitely outside
+ * of the threshold. the remaining pairs are re-evaluated on the original
+ * coordinates, thus results are exactly the same as without partial distances.
+ */
+
+namespace Clustering {
+namespace Density {
+//! early abandonment of distance computations on variance-ordered columns
+namespace PartialDistances {
+  //! number of columns summed up (as vector) before checking the threshold
+  const std::size_t CHUNK_SIZE = 8;
+  //! coordinates with columns in order of decreasing variance
+  struct OrderedCoords {
+    std::size_t n_rows;
+    std::size_t n_cols;
+    //! number of columns, padded with zeros to a multiple of CHUNK_SIZE
+    std::size_t n_padded_cols;
+    //! original column index of every ordered column
+    std::vector<std::size_t> col_order;
+    //! ordered coordinates, format: [row * n_padded_cols + col]
+    std::vector<float> coords;
+    //! relative tolerance, covering rounding errors of the partial
+    //! and of the full precision distance computation
+    double tolerance;
+  };
+  //! copy coordinates with columns in order of decreasing variance
+  OrderedCoords
+  variance_ordered_coords(const float* coords,
+                          const std::size_t n_rows,
+                          const std::size_t n_cols);
+  //! partial squared distances between frame 'i' and the frames with ids
+  //! 'frames[0]' ... 'frames[n_frames-1]'. the summation of every distance
+  //! stops at the first chunk of columns reaching 'reject_thr'.
+  //! returns the number of evaluated columns (summed over all frames).
+  std::size_t
+  partial_squared_distances(const OrderedCoords& oc,
+                            const std::size_t i,
+                            const std::size_t* frames,
+                            const std::size_t n_frames,
+                            const float reject_thr,
+                            float* partial_dist2);
+  //! same as above, with individual thresholds 'reject_thr[0]' ... 'reject_thr[n_frames-1]'.
+  std::size_t
+  partial_squared_distances(const OrderedCoords& oc,
+                            const std::size_t i,
+                            const std::size_t* frames,
+                            const std::size_t n_frames,
+                            const float* reject_thr,
+                            float* partial_dist2);
+  //! partial squared distances at or above this threshold guarantee
+  //! that the full precision squared distance (as computed by the kernels
+  //! of Clustering::Density::SIMD) is not below 'rad2'.
+  float
+  reject_threshold(const OrderedCoords& oc,
+                   const float rad2);
+} // end namespace PartialDistances
+} // end namespace Density
+} // end namespace Clustering
+
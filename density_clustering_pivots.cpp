@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_pivots.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace Clustering {
+namespace Density {
+namespace Pivots {
+
+  PivotTable
+  compute_pivot_table(const float* coords,
+                      const std::size_t n_rows,
+                      const std::size_t n_cols,
+                      const std::size_t n_pivots) {
+    PivotTable pt;
+    pt.n_rows = n_rows;
+    pt.n_pivots = std::min(n_pivots, n_rows);
+    // rounding errors of the distances grow linearly with
+    // the number of summed up dimensions
+    pt.tolerance = 4.0 * (n_cols + 4) * std::numeric_limits<float>::epsilon();
+    pt.dist.resize(pt.n_pivots*n_rows);
+    // min. distance of every frame to the pivots selected so far
+    std::vector<double> min_dist(n_rows);
+    std::vector<double> dist(n_rows);
+    // start from the frame farthest from the first one
+    std::size_t next_pivot = 0;
+    std::size_t i, k;
+    for (std::size_t l=0; l <= pt.n_pivots; ++l) {
+      const float* ref = &coords[next_pivot*n_cols];
+      // distances in double precision, independent of the distance kernels
+      #pragma omp parallel for default(none) private(i,k)\
+        firstprivate(n_rows,n_cols,ref)\
+        shared(coords,dist)
+      for (i=0; i < n_rows; ++i) {
+        double d2 = 0.0;
+        for (k=0; k < n_cols; ++k) {
+          double d = (double) coords[i*n_cols+k] - (double) ref[k];
+          d2 += d*d;
+        }
+        dist[i] = std::sqrt(d2);
+      }
+      if (l == 0) {
+        min_dist = dist;
+      } else {
+        // store distances to pivot selected in previous step
+        for (i=0; i < n_rows; ++i) {
+          pt.dist[(l-1)*n_rows+i] = (float) dist[i];
+          min_dist[i] = (l == 1 ? dist[i] : std::min(min_dist[i], dist[i]));
+        }
+      }
+      if (l < pt.n_pivots) {
+        // farthest frame from all pivots (lowest id on ties)
+        next_pivot = std::max_element(min_dist.begin(), min_dist.end()) - min_dist.begin();
+        pt.pivots.push_back(next_pivot);
+      }
+    }
+    return pt;
+  }
+
+  void
+  distance_bounds(const PivotTable& pt,
+                  const std::size_t i,
+                  const std::size_t j_from,
+                  const std::size_t n_frames,
+                  float* lower,
+                  float* upper) {
+    const std::size_t n_rows = pt.n_rows;
+    const float tol = (float) pt.tolerance;
+    std::fill(lower, lower+n_frames, 0.0f);
+    std::fill(upper, upper+n_frames, std::numeric_limits<float>::max());
+    // pivot-wise over contiguous distances, vectorized over the frames.
+    for (std::size_t l=0; l < pt.n_pivots; ++l) {
+      const float* d_j = &pt.dist[l*n_rows + j_from];
+      const float d_i = pt.dist[l*n_rows + i];
+      for (std::size_t j=0; j < n_frames; ++j) {
+        // widened by the rounding errors of the stored distances
+        float d_sum = d_i + d_j[j];
+        lower[j] = std::max(lower[j], std::abs(d_i - d_j[j]) - tol*d_sum);
+        upper[j] = std::min(upper[j], d_sum + tol*d_sum);
+      }
+    }
+  }
+
+  float
+  reject_threshold(const PivotTable& pt,
+                   const float rad2) {
+    return (float) (std::sqrt((double) rad2) * (1.0 + pt.tolerance));
+  }
+
+  float
+  accept_threshold(const PivotTable& pt,
+                   const float rad2) {
+    return (float) (std::sqrt((double) rad2) * (1.0 - pt.tolerance));
+  }
+
+} // end namespace Pivots
+} // end namespace Density
+} // end namespace Clustering
+
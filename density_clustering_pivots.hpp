@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/*! \file
+ * pivot table for triangle-inequality pruning (LAESA).
+ *
+ * the distances of all frames to a small set of pivot frames are
+ * precomputed. for every pivot p, the triangle inequality gives
+ *
+ *   |d(i,p) - d(j,p)|  <=  d(i,j)  <=  d(i,p) + d(j,p),
+ *
+ * i.e. lower and upper bounds of pair distances on all dimensions
+ * without touching the coordinates. pairs decided by these bounds are
+ * not computed at all, thus results are exactly the same as without
+ * pivots.
+ */
+
+namespace Clustering {
+namespace Density {
+//! triangle-inequality pruning with precomputed pivot distances
+namespace Pivots {
+  //! distances of all frames to the pivot frames
+  struct PivotTable {
+    std::size_t n_rows;
+    std::size_t n_pivots;
+    //! frame ids of pivots
+    std::vector<std::size_t> pivots;
+    //! (non-squared) distances to pivots, column-major format: [pivot * n_rows + row]
+    std::vector<float> dist;
+    //! relative tolerance, covering rounding errors of the
+    //! pivot distances and of the full precision distance computation
+    double tolerance;
+  };
+  //! select 'n_pivots' frames by farthest-first traversal
+  //! (every new pivot is the frame farthest from all previous ones)
+  //! and compute the distances of all frames to them.
+  PivotTable
+  compute_pivot_table(const float* coords,
+                      const std::size_t n_rows,
+                      const std::size_t n_cols,
+                      const std::size_t n_pivots);
+  //! bounds of (non-squared) distances between frame 'i' and the
+  //! 'n_frames' consecutive frames starting at 'j_from'.
+  void
+  distance_bounds(const PivotTable& pt,
+                  const std::size_t i,
+                  const std::size_t j_from,
+                  const std::size_t n_frames,
+                  float* lower,
+                  float* upper);
+  //! lower distance bounds at or above this threshold guarantee that
+  //! the full precision squared distance (as computed by the kernels
+  //! of Clustering::Density::SIMD) is not below 'rad2'.
+  float
+  reject_threshold(const PivotTable& pt,
+                   const float rad2);
+  //! upper distance bounds below this threshold guarantee that
+  //! the full precision squared distance is below 'rad2'.
+  float
+  accept_threshold(const PivotTable& pt,
+                   const float rad2);
+} // end namespace Pivots
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_prefilter.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace Clustering {
+namespace Density {
+namespace Prefilter {
+
+  CompressedCoords
+  compress_coords(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols) {
+    CompressedCoords cc;
+    cc.n_rows = n_rows;
+    cc.n_cols = n_cols;
+    // rounding errors of the squared distances grow linearly with
+    // the number of summed up dimensions
+    cc.tolerance = 4.0 * (n_cols + 4) * std::numeric_limits<float>::epsilon();
+    cc.codes.resize(n_rows*n_cols);
+    cc.step.resize(n_cols);
+    double sum_error2 = 0.0;
+    for (std::size_t k=0; k < n_cols; ++k) {
+      float min_x = std::numeric_limits<float>::max();
+      float max_x = std::numeric_limits<float>::lowest();
+      for (std::size_t i=0; i < n_rows; ++i) {
+        min_x = std::min(min_x, coords[i*n_cols+k]);
+        max_x = std::max(max_x, coords[i*n_cols+k]);
+      }
+      const float step = (float) (((double) max_x - (double) min_x) / 255.0);
+      // keep track of the actual max. quantization error
+      // w.r.t. the (single precision) step used for distances
+      double max_error = 0.0;
+      for (std::size_t i=0; i < n_rows; ++i) {
+        double code = 0.0;
+        if (step > 0.0f) {
+          code = std::min(255.0, std::max(0.0, std::round((coords[i*n_cols+k] - (double) min_x) / step)));
+        }
+        cc.codes[k*n_rows+i] = (uint8_t) code;
+        max_error = std::max(max_error
+                           , std::abs(coords[i*n_cols+k] - ((double) min_x + code*step)));
+      }
+      cc.step[k] = step;
+      // error of a difference of two quantized values
+      sum_error2 += 4.0 * max_error * max_error;
+    }
+    // rounded up to be on the safe side
+    cc.max_error = std::sqrt(sum_error2) * (1.0 + cc.tolerance);
+    return cc;
+  }
+
+  void
+  approx_squared_distances(const CompressedCoords& cc,
+                           const std::size_t i,
+                           const std::size_t j_from,
+                           const std::size_t n_frames,
+                           float* approx_dist2) {
+    const std::size_t n_rows = cc.n_rows;
+    const std::size_t n_cols = cc.n_cols;
+    std::fill(approx_dist2, approx_dist2+n_frames, 0.0f);
+    // column-wise accumulation over contiguous codes,
+    // vectorized over the frames.
+    for (std::size_t k=0; k < n_cols; ++k) {
+      const uint8_t* y = &cc.codes[k*n_rows + j_from];
+      const int ref = cc.codes[k*n_rows + i];
+      const float step = cc.step[k];
+      for (std::size_t j=0; j < n_frames; ++j) {
+        float d = (float) (ref - (int) y[j]) * step;
+        approx_dist2[j] += d*d;
+      }
+    }
+  }
+
+  float
+  reject_threshold(const CompressedCoords& cc,
+                   const float rad2) {
+    double r = std::sqrt((double) rad2) + cc.max_error;
+    r = r * r * (1.0 + cc.tolerance);
+    if (r > std::numeric_limits<float>::max()) {
+      return std::numeric_limits<float>::infinity();
+    }
+    return (float) r;
+  }
+
+  float
+  accept_threshold(const CompressedCoords& cc,
+                   const float rad2) {
+    double r = std::sqrt((double) rad2) - cc.max_error;
+    if (r <= 0.0) {
+      return 0.0f;
+    }
+    return (float) (r * r * (1.0 - cc.tolerance));
+  }
+
+} // end namespace Prefilter
+} // end namespace Density
+} // end namespace Clustering
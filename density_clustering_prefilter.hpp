@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*! \file
+ * compressed coordinates for fast rejection / acceptance of frame pairs.
+ *
+ * every column is quantized to 8 bit with its own scaling. the euclidean
+ * distance of two compressed frames differs from the true distance by at
+ * most a constant 'max_error' (triangle inequality), thus comparisons
+ * against a radius can be decided on the compressed coordinates with
+ * thresholds widened by the error.
+ * only pairs that are not decided this way are re-evaluated on the full
+ * precision coordinates, thus results are exactly the same as without
+ * prefilter, at a quarter of the memory traffic for the decided pairs.
+ */
+
+namespace Clustering {
+namespace Density {
+//! reduced-precision prefilter for distance comparisons
+namespace Prefilter {
+  //! 8-bit quantized coordinates with per-column scaling
+  struct CompressedCoords {
+    std::size_t n_rows;
+    std::size_t n_cols;
+    //! quantized coordinates, column-major format: [col * n_rows + row]
+    std::vector<uint8_t> codes;
+    //! quantization step per column
+    std::vector<float> step;
+    //! max. deviation of the distance between compressed
+    //! frames from the true distance
+    double max_error;
+    //! relative tolerance, covering rounding errors of the
+    //! approximate and of the full precision distance computation
+    double tolerance;
+  };
+  //! compress coordinates to 8 bit per value
+  CompressedCoords
+  compress_coords(const float* coords,
+                  const std::size_t n_rows,
+                  const std::size_t n_cols);
+  //! approximate squared distances between frame 'i' and the
+  //! 'n_frames' consecutive frames starting at 'j_from'.
+  void
+  approx_squared_distances(const CompressedCoords& cc,
+                           const std::size_t i,
+                           const std::size_t j_from,
+                           const std::size_t n_frames,
+                           float* approx_dist2);
+  //! approximate squared distances at or above this threshold guarantee
+  //! that the full precision squared distance (as computed by the kernels
+  //! of Clustering::Density::SIMD) is not below 'rad2'.
+  float
+  reject_threshold(const CompressedCoords& cc,
+                   const float rad2);
+  //! approximate squared distances below this threshold guarantee that
+  //! the full precision squared distance is below 'rad2'.
+  float
+  accept_threshold(const CompressedCoords& cc,
+                   const float rad2);
+} // end namespace Prefilter
+} // end namespace Density
+} // end namespace Clustering
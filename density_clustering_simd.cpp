@@ -0,0 +1,468 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_simd.hpp"
+#include "logger.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define DC_SIMD_X86
+  #include <immintrin.h>
+#endif
+
+// this file has to be compiled without '-ffast-math' and without
+// floating point contraction (see CMakeLists.txt): the summation order
+// of the distances must not be changed by the compiler.
+
+namespace Clustering {
+namespace Density {
+namespace SIMD {
+
+  namespace {
+    //! one-to-many distances of consecutive frames
+    using BatchKernel = void (*)(const float*, const float*, std::size_t, std::size_t, float*);
+    //! one-to-many distances of indexed frames
+    using IndexedKernel = void (*)(const float*, const float*, const std::size_t*, std::size_t, std::size_t, float*);
+
+    float
+    distance_scalar(const float* x,
+                    const float* y,
+                    const std::size_t n_cols) {
+      float dist2 = 0.0f;
+      for (std::size_t k=0; k < n_cols; ++k) {
+        float c = x[k] - y[k];
+        dist2 += c*c;
+      }
+      return dist2;
+    }
+
+    void
+    batch_scalar(const float* ref,
+                 const float* coords,
+                 std::size_t n_frames,
+                 std::size_t n_cols,
+                 float* dist2) {
+      for (std::size_t j=0; j < n_frames; ++j) {
+        dist2[j] = distance_scalar(ref, &coords[j*n_cols], n_cols);
+      }
+    }
+
+    void
+    indexed_scalar(const float* ref,
+                   const float* coords,
+                   const std::size_t* frames,
+                   std::size_t n_frames,
+                   std::size_t n_cols,
+                   float* dist2) {
+      for (std::size_t j=0; j < n_frames; ++j) {
+        dist2[j] = distance_scalar(ref, &coords[frames[j]*n_cols], n_cols);
+      }
+    }
+
+#ifdef DC_SIMD_X86
+    // the vectorized kernels compute the distances of a block of
+    // frames (one per vector lane) given by pointers to their coordinates.
+    // columns are loaded row-wise and transposed in registers, such that
+    // every lane adds up its own distance column by column.
+    // AVX kernels clear the upper register halves before handing the
+    // remaining frames over to SSE code, to avoid transition penalties.
+
+    // SSE2: block of 4 frames, columns are transposed in steps of 4
+    __attribute__((target("sse2")))
+    __m128
+    block_sse2(const float* ref,
+               const float* const* y,
+               std::size_t n_cols) {
+      __m128 acc = _mm_setzero_ps();
+      std::size_t k = 0;
+      for (; k+4 <= n_cols; k += 4) {
+        __m128 c0 = _mm_loadu_ps(&y[0][k]);
+        __m128 c1 = _mm_loadu_ps(&y[1][k]);
+        __m128 c2 = _mm_loadu_ps(&y[2][k]);
+        __m128 c3 = _mm_loadu_ps(&y[3][k]);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        __m128 cols[4] = {c0, c1, c2, c3};
+        for (std::size_t m=0; m < 4; ++m) {
+          __m128 c = _mm_sub_ps(_mm_set1_ps(ref[k+m]), cols[m]);
+          acc = _mm_add_ps(acc, _mm_mul_ps(c, c));
+        }
+      }
+      for (; k < n_cols; ++k) {
+        __m128 c = _mm_sub_ps(_mm_set1_ps(ref[k])
+                            , _mm_setr_ps(y[0][k], y[1][k], y[2][k], y[3][k]));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c, c));
+      }
+      return acc;
+    }
+
+    __attribute__((target("sse2")))
+    void
+    batch_sse2(const float* ref,
+               const float* coords,
+               std::size_t n_frames,
+               std::size_t n_cols,
+               float* dist2) {
+      std::size_t j = 0;
+      const float* y[4];
+      for (; j+4 <= n_frames; j += 4) {
+        for (std::size_t t=0; t < 4; ++t) {
+          y[t] = &coords[(j+t)*n_cols];
+        }
+        _mm_storeu_ps(&dist2[j], block_sse2(ref, y, n_cols));
+      }
+      batch_scalar(ref, &coords[j*n_cols], n_frames-j, n_cols, &dist2[j]);
+    }
+
+    __attribute__((target("sse2")))
+    void
+    indexed_sse2(const float* ref,
+                 const float* coords,
+                 const std::size_t* frames,
+                 std::size_t n_frames,
+                 std::size_t n_cols,
+                 float* dist2) {
+      std::size_t j = 0;
+      const float* y[4];
+      for (; j+4 <= n_frames; j += 4) {
+        for (std::size_t t=0; t < 4; ++t) {
+          y[t] = &coords[frames[j+t]*n_cols];
+        }
+        _mm_storeu_ps(&dist2[j], block_sse2(ref, y, n_cols));
+      }
+      indexed_scalar(ref, coords, &frames[j], n_frames-j, n_cols, &dist2[j]);
+    }
+
+    // AVX2: block of 8 frames, columns are transposed in steps of 8
+    __attribute__((target("avx2")))
+    __m256
+    block_avx2(const float* ref,
+               const float* const* y,
+               std::size_t n_cols) {
+      __m256 acc = _mm256_setzero_ps();
+      __m256 r[8];
+      __m256 t[8];
+      __m256 u[8];
+      __m256 cols[8];
+      for (std::size_t k=0; k < n_cols; k += 8) {
+        const std::size_t n_block = std::min<std::size_t>(8, n_cols-k);
+        if (n_block == 8) {
+          for (std::size_t i=0; i < 8; ++i) {
+            r[i] = _mm256_loadu_ps(&y[i][k]);
+          }
+        } else {
+          // masked load of remaining columns
+          const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int) n_block)
+                                                , _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+          for (std::size_t i=0; i < 8; ++i) {
+            r[i] = _mm256_maskload_ps(&y[i][k], mask);
+          }
+        }
+        for (std::size_t i=0; i < 8; i += 2) {
+          t[i] = _mm256_unpacklo_ps(r[i], r[i+1]);
+          t[i+1] = _mm256_unpackhi_ps(r[i], r[i+1]);
+        }
+        for (std::size_t i=0; i < 8; i += 4) {
+          u[i] = _mm256_shuffle_ps(t[i], t[i+2], 0x44);
+          u[i+1] = _mm256_shuffle_ps(t[i], t[i+2], 0xEE);
+          u[i+2] = _mm256_shuffle_ps(t[i+1], t[i+3], 0x44);
+          u[i+3] = _mm256_shuffle_ps(t[i+1], t[i+3], 0xEE);
+        }
+        for (std::size_t m=0; m < 4; ++m) {
+          cols[m] = _mm256_permute2f128_ps(u[m], u[4+m], 0x20);
+          cols[4+m] = _mm256_permute2f128_ps(u[m], u[4+m], 0x31);
+        }
+        for (std::size_t m=0; m < n_block; ++m) {
+          __m256 c = _mm256_sub_ps(_mm256_set1_ps(ref[k+m]), cols[m]);
+          acc = _mm256_add_ps(acc, _mm256_mul_ps(c, c));
+        }
+      }
+      return acc;
+    }
+
+    __attribute__((target("avx2")))
+    void
+    batch_avx2(const float* ref,
+               const float* coords,
+               std::size_t n_frames,
+               std::size_t n_cols,
+               float* dist2) {
+      std::size_t j = 0;
+      const float* y[8];
+      for (; j+8 <= n_frames; j += 8) {
+        for (std::size_t t=0; t < 8; ++t) {
+          y[t] = &coords[(j+t)*n_cols];
+        }
+        _mm256_storeu_ps(&dist2[j], block_avx2(ref, y, n_cols));
+      }
+      _mm256_zeroupper();
+      batch_sse2(ref, &coords[j*n_cols], n_frames-j, n_cols, &dist2[j]);
+    }
+
+    __attribute__((target("avx2")))
+    void
+    indexed_avx2(const float* ref,
+                 const float* coords,
+                 const std::size_t* frames,
+                 std::size_t n_frames,
+                 std::size_t n_cols,
+                 float* dist2) {
+      std::size_t j = 0;
+      const float* y[8];
+      for (; j+8 <= n_frames; j += 8) {
+        for (std::size_t t=0; t < 8; ++t) {
+          y[t] = &coords[frames[j+t]*n_cols];
+        }
+        _mm256_storeu_ps(&dist2[j], block_avx2(ref, y, n_cols));
+      }
+      _mm256_zeroupper();
+      indexed_sse2(ref, coords, &frames[j], n_frames-j, n_cols, &dist2[j]);
+    }
+
+    // AVX-512: block of 16 frames, columns are transposed in steps of 16.
+    // (the pragmas silence false positives of GCC's avx512 intrinsics header)
+    //! for less columns, the 16x16 transposition does not pay off
+    //! and the AVX2 kernels are faster.
+    const std::size_t AVX512_MIN_COLS = 64;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    __attribute__((target("avx512f")))
+    __m512
+    block_avx512(const float* ref,
+                 const float* const* y,
+                 std::size_t n_cols) {
+      __m512 acc = _mm512_setzero_ps();
+      __m512 r[16];
+      __m512 t[16];
+      __m512 u[16];
+      __m512 cols[16];
+      for (std::size_t k=0; k < n_cols; k += 16) {
+        const std::size_t n_block = std::min<std::size_t>(16, n_cols-k);
+        // masked load of (remaining) columns
+        const __mmask16 mask = (__mmask16) ((1u << n_block) - 1);
+        for (std::size_t i=0; i < 16; ++i) {
+          r[i] = _mm512_maskz_loadu_ps(mask, &y[i][k]);
+        }
+        for (std::size_t i=0; i < 16; i += 2) {
+          t[i] = _mm512_unpacklo_ps(r[i], r[i+1]);
+          t[i+1] = _mm512_unpackhi_ps(r[i], r[i+1]);
+        }
+        // u[4*g+m]: column 4*L+m of frames 4*g ... 4*g+3 in 128-bit lane L
+        for (std::size_t i=0; i < 16; i += 4) {
+          u[i] = _mm512_shuffle_ps(t[i], t[i+2], 0x44);
+          u[i+1] = _mm512_shuffle_ps(t[i], t[i+2], 0xEE);
+          u[i+2] = _mm512_shuffle_ps(t[i+1], t[i+3], 0x44);
+          u[i+3] = _mm512_shuffle_ps(t[i+1], t[i+3], 0xEE);
+        }
+        for (std::size_t m=0; m < 4; ++m) {
+          __m512 lo_ab = _mm512_shuffle_f32x4(u[m], u[4+m], 0x44);
+          __m512 hi_ab = _mm512_shuffle_f32x4(u[m], u[4+m], 0xEE);
+          __m512 lo_cd = _mm512_shuffle_f32x4(u[8+m], u[12+m], 0x44);
+          __m512 hi_cd = _mm512_shuffle_f32x4(u[8+m], u[12+m], 0xEE);
+          cols[m] = _mm512_shuffle_f32x4(lo_ab, lo_cd, 0x88);
+          cols[4+m] = _mm512_shuffle_f32x4(lo_ab, lo_cd, 0xDD);
+          cols[8+m] = _mm512_shuffle_f32x4(hi_ab, hi_cd, 0x88);
+          cols[12+m] = _mm512_shuffle_f32x4(hi_ab, hi_cd, 0xDD);
+        }
+        for (std::size_t m=0; m < n_block; ++m) {
+          __m512 c = _mm512_sub_ps(_mm512_set1_ps(ref[k+m]), cols[m]);
+          acc = _mm512_add_ps(acc, _mm512_mul_ps(c, c));
+        }
+      }
+      return acc;
+    }
+
+    __attribute__((target("avx512f")))
+    void
+    batch_avx512(const float* ref,
+                 const float* coords,
+                 std::size_t n_frames,
+                 std::size_t n_cols,
+                 float* dist2) {
+      if (n_cols < AVX512_MIN_COLS) {
+        batch_avx2(ref, coords, n_frames, n_cols, dist2);
+        return;
+      }
+      std::size_t j = 0;
+      const float* y[16];
+      for (; j+16 <= n_frames; j += 16) {
+        for (std::size_t t=0; t < 16; ++t) {
+          y[t] = &coords[(j+t)*n_cols];
+        }
+        _mm512_storeu_ps(&dist2[j], block_avx512(ref, y, n_cols));
+      }
+      _mm256_zeroupper();
+      batch_avx2(ref, &coords[j*n_cols], n_frames-j, n_cols, &dist2[j]);
+    }
+
+    __attribute__((target("avx512f")))
+    void
+    indexed_avx512(const float* ref,
+                   const float* coords,
+                   const std::size_t* frames,
+                   std::size_t n_frames,
+                   std::size_t n_cols,
+                   float* dist2) {
+      if (n_cols < AVX512_MIN_COLS) {
+        indexed_avx2(ref, coords, frames, n_frames, n_cols, dist2);
+        return;
+      }
+      std::size_t j = 0;
+      const float* y[16];
+      for (; j+16 <= n_frames; j += 16) {
+        for (std::size_t t=0; t < 16; ++t) {
+          y[t] = &coords[frames[j+t]*n_cols];
+        }
+        _mm512_storeu_ps(&dist2[j], block_avx512(ref, y, n_cols));
+      }
+      _mm256_zeroupper();
+      indexed_avx2(ref, coords, &frames[j], n_frames-j, n_cols, &dist2[j]);
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    //! currently selected kernels
+    struct Kernels {
+      InstructionSet isa;
+      BatchKernel batch;
+      IndexedKernel indexed;
+    };
+
+    Kernels
+    kernels(InstructionSet isa) {
+      switch (isa) {
+#ifdef DC_SIMD_X86
+        case AVX512:
+          return {AVX512, batch_avx512, indexed_avx512};
+        case AVX2:
+          return {AVX2, batch_avx2, indexed_avx2};
+        case SSE2:
+          return {SSE2, batch_sse2, indexed_sse2};
+#endif
+        default:
+          return {SCALAR, batch_scalar, indexed_scalar};
+      }
+    }
+
+    Kernels&
+    active_kernels() {
+      static Kernels active = kernels(detect_instruction_set());
+      return active;
+    }
+  } // end local namespace
+
+  InstructionSet
+  detect_instruction_set() {
+#ifdef DC_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return AVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+      return AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      return SSE2;
+    }
+#endif
+    return SCALAR;
+  }
+
+  InstructionSet
+  instruction_set() {
+    return active_kernels().isa;
+  }
+
+  std::string
+  instruction_set_name(InstructionSet isa) {
+    switch (isa) {
+      case AVX512:
+        return "avx512";
+      case AVX2:
+        return "avx2";
+      case SSE2:
+        return "sse2";
+      default:
+        return "scalar";
+    }
+  }
+
+  void
+  select_instruction_set(const std::string name) {
+    InstructionSet best = detect_instruction_set();
+    InstructionSet isa = best;
+    if (name != "auto") {
+      bool known = false;
+      for (InstructionSet i: {SCALAR, SSE2, AVX2, AVX512}) {
+        if (name == instruction_set_name(i)) {
+          isa = i;
+          known = true;
+        }
+      }
+      if ( ! known) {
+        std::cerr << "error: unknown instruction set '" << name << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      if (isa > best) {
+        std::cerr << "error: instruction set '" << name
+                  << "' is not supported by this CPU." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    active_kernels() = kernels(isa);
+    Clustering::logger(std::cout) << "using " << instruction_set_name(isa)
+                                  << " distance kernels" << std::endl;
+  }
+
+  float
+  squared_distance(const float* x,
+                   const float* y,
+                   const std::size_t n_cols) {
+    return distance_scalar(x, y, n_cols);
+  }
+
+  void
+  squared_distances(const float* ref,
+                    const float* coords,
+                    const std::size_t n_frames,
+                    const std::size_t n_cols,
+                    float* dist2) {
+    active_kernels().batch(ref, coords, n_frames, n_cols, dist2);
+  }
+
+  void
+  squared_distances(const float* ref,
+                    const float* coords,
+                    const std::size_t* frames,
+                    const std::size_t n_frames,
+                    const std::size_t n_cols,
+                    float* dist2) {
+    active_kernels().indexed(ref, coords, frames, n_frames, n_cols, dist2);
+  }
+
+} // end namespace SIMD
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/*! \file
+ * vectorized squared euclidean distances for the density computations.
+ *
+ * all kernels are compiled into the same binary and the best instruction
+ * set supported by the CPU is chosen at runtime. thus, a single binary
+ * runs (and uses the vector units) on heterogeneous cluster nodes.
+ *
+ * the vectorized kernels compute distances of several frames at once
+ * (one frame per vector lane), but sum up every single distance
+ * dimension by dimension in plain order, just like the scalar kernel.
+ * all instruction sets therefore give bit-identical results.
+ */
+
+namespace Clustering {
+namespace Density {
+//! runtime-dispatched, vectorized distance kernels
+namespace SIMD {
+  //! instruction sets with distance kernels
+  enum InstructionSet {
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512
+  };
+  //! best instruction set supported by this CPU
+  InstructionSet
+  detect_instruction_set();
+  //! instruction set currently used by the distance kernels
+  InstructionSet
+  instruction_set();
+  //! name of given instruction set ('scalar', 'sse2', 'avx2', 'avx512')
+  std::string
+  instruction_set_name(InstructionSet isa);
+  /*!
+   * select instruction set of the distance kernels by name.
+   * 'auto' chooses the best one supported by the CPU.
+   * exits with an error if the instruction set is unknown
+   * or not supported.
+   * must not be called concurrently to the kernels.
+   */
+  void
+  select_instruction_set(const std::string name);
+  //! squared euclidean distance between two frames
+  float
+  squared_distance(const float* x,
+                   const float* y,
+                   const std::size_t n_cols);
+  /*!
+   * squared euclidean distances of reference frame 'ref' to
+   * the 'n_frames' consecutive frames starting at 'coords'.
+   * results are written to 'dist2[0]' ... 'dist2[n_frames-1]'.
+   */
+  void
+  squared_distances(const float* ref,
+                    const float* coords,
+                    const std::size_t n_frames,
+                    const std::size_t n_cols,
+                    float* dist2);
+  /*!
+   * squared euclidean distances of reference frame 'ref' to
+   * the frames with ids 'frames[0]' ... 'frames[n_frames-1]'.
+   * results are written to 'dist2[0]' ... 'dist2[n_frames-1]'.
+   */
+  void
+  squared_distances(const float* ref,
+                    const float* coords,
+                    const std::size_t* frames,
+                    const std::size_t n_frames,
+                    const std::size_t n_cols,
+                    float* dist2);
+} // end namespace SIMD
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,211 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "density_clustering_tiles.hpp"
+#include "logger.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+namespace Clustering {
+namespace Density {
+namespace Tiles {
+
+  namespace {
+    //! identifier of checkpoint files (and format version)
+    const char FILE_MAGIC[8] = {'D', 'C', 'T', 'I', 'L', 'E', 'S', '1'};
+
+    //! checksum of a tile record
+    uint64_t
+    record_checksum(const uint64_t i_tile,
+                    const std::vector<uint64_t>& values) {
+      return fingerprint(values.data()
+                       , values.size()*sizeof(uint64_t)
+                       , fingerprint(&i_tile, sizeof(i_tile)));
+    }
+
+    //! write record of single tile: index, number of values, values, checksum
+    void
+    write_record(std::ofstream& ofs,
+                 const uint64_t i_tile,
+                 const std::vector<uint64_t>& values) {
+      uint64_t n_values = values.size();
+      uint64_t checksum = record_checksum(i_tile, values);
+      ofs.write(reinterpret_cast<const char*>(&i_tile), sizeof(i_tile));
+      ofs.write(reinterpret_cast<const char*>(&n_values), sizeof(n_values));
+      ofs.write(reinterpret_cast<const char*>(values.data()), n_values*sizeof(uint64_t));
+      ofs.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    }
+
+    //! write file header: magic, fingerprint, number of tiles
+    void
+    write_header(std::ofstream& ofs,
+                 const uint64_t fingerprint,
+                 const uint64_t n_tiles) {
+      ofs.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+      ofs.write(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+      ofs.write(reinterpret_cast<const char*>(&n_tiles), sizeof(n_tiles));
+    }
+  } // end local namespace
+
+  uint64_t
+  fingerprint(const void* data,
+              const std::size_t n_bytes,
+              uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i=0; i < n_bytes; ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  Checkpoint
+  open_checkpoint(const Parameters& params,
+                  const std::string kind,
+                  const std::vector<std::size_t>& n_tile_values,
+                  const uint64_t input_fingerprint) {
+    const std::size_t n_tiles = n_tile_values.size();
+    Checkpoint checkpoint;
+    checkpoint.filename = params.filename;
+    checkpoint.enabled = ! params.filename.empty();
+    checkpoint.done.assign(n_tiles, false);
+    checkpoint.values.resize(n_tiles);
+    if ( ! checkpoint.enabled) {
+      return checkpoint;
+    }
+    const uint64_t fp = fingerprint(kind.data(), kind.size(), input_fingerprint);
+    std::size_t n_done = 0;
+    if (params.resume && std::ifstream(params.filename).good()) {
+      std::ifstream ifs(params.filename, std::ios::binary);
+      char magic[sizeof(FILE_MAGIC)];
+      uint64_t file_fp = 0;
+      uint64_t file_n_tiles = 0;
+      ifs.read(magic, sizeof(magic));
+      ifs.read(reinterpret_cast<char*>(&file_fp), sizeof(file_fp));
+      ifs.read(reinterpret_cast<char*>(&file_n_tiles), sizeof(file_n_tiles));
+      if (ifs.fail() || std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        std::cerr << "error: '" << params.filename << "' is not a tile checkpoint file." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      if (file_fp != fp || file_n_tiles != n_tiles) {
+        std::cerr << "error: tile checkpoint '" << params.filename << "' does not match the "
+                  << kind << " computation with the given data and parameters." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      // read all complete tiles, an interrupted write leaves
+      // a truncated (or inconsistent) record at the end.
+      while (true) {
+        uint64_t i_tile = 0;
+        uint64_t n_values = 0;
+        uint64_t checksum = 0;
+        ifs.read(reinterpret_cast<char*>(&i_tile), sizeof(i_tile));
+        ifs.read(reinterpret_cast<char*>(&n_values), sizeof(n_values));
+        // (checked before allocation, the length may be garbage)
+        if (ifs.fail() || i_tile >= n_tiles || n_values != n_tile_values[i_tile]) {
+          break;
+        }
+        std::vector<uint64_t> values(n_values);
+        ifs.read(reinterpret_cast<char*>(values.data()), n_values*sizeof(uint64_t));
+        ifs.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+        if (ifs.fail() || checksum != record_checksum(i_tile, values)) {
+          break;
+        }
+        if ( ! checkpoint.done[i_tile]) {
+          checkpoint.done[i_tile] = true;
+          checkpoint.values[i_tile].swap(values);
+          ++n_done;
+        }
+      }
+      Clustering::logger(std::cout) << "resuming " << kind << " computation: "
+                                    << n_done << " of " << n_tiles << " tiles done" << std::endl;
+    }
+    // (re-)write file with complete tiles only, such that
+    // new tiles are appended to consistent data.
+    const std::string tmp_filename = params.filename + ".tmp";
+    {
+      std::ofstream ofs(tmp_filename, std::ios::binary);
+      if (ofs.fail()) {
+        std::cerr << "error: cannot open file '" << tmp_filename << "' for writing." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      write_header(ofs, fp, n_tiles);
+      for (std::size_t i_tile=0; i_tile < n_tiles; ++i_tile) {
+        if (checkpoint.done[i_tile]) {
+          write_record(ofs, i_tile, checkpoint.values[i_tile]);
+        }
+      }
+      ofs.close();
+      if (ofs.fail()) {
+        std::cerr << "error: cannot write tile checkpoint to '" << tmp_filename << "'." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (std::rename(tmp_filename.c_str(), params.filename.c_str()) != 0) {
+      std::cerr << "error: cannot replace tile checkpoint '" << params.filename << "'." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    return checkpoint;
+  }
+
+  void
+  save_tile(Checkpoint& checkpoint,
+            const std::size_t i_tile,
+            const std::vector<uint64_t>& values) {
+    checkpoint.done[i_tile] = true;
+    if ( ! checkpoint.enabled) {
+      return;
+    }
+    std::ofstream ofs(checkpoint.filename, std::ios::binary | std::ios::app);
+    write_record(ofs, i_tile, values);
+    ofs.close();
+    if (ofs.fail()) {
+      std::cerr << "error: cannot write tile checkpoint to '" << checkpoint.filename << "'." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  uint64_t
+  float_value(const float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+  }
+
+  float
+  value_float(const uint64_t v) {
+    uint32_t bits = (uint32_t) v;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+
+} // end namespace Tiles
+} // end namespace Density
+} // end namespace Clustering
+
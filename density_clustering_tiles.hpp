@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2015, Florian Sittel (www.lettis.net)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/*! \file
+ * tile-level checkpoints of long-running population and nearest neighbor
+ * computations.
+ *
+ * the frames are split into deterministic tiles. results of every finished
+ * tile are appended to a checkpoint file, such that an interrupted run
+ * (e.g. a preempted batch job) only recomputes the unfinished tiles.
+ * the file starts with a fingerprint of all inputs, resuming with
+ * different data or parameters is refused. incompletely written
+ * tiles at the end of the file are discarded.
+ */
+
+namespace Clustering {
+namespace Density {
+//! checkpoints of tiled computations
+namespace Tiles {
+  //! checkpoint settings
+  struct Parameters {
+    //! checkpoint file, no checkpoints (and a single tile) if empty
+    std::string filename;
+    //! number of frames per tile
+    std::size_t tile_size;
+    //! resume from existing checkpoint file
+    bool resume;
+  };
+  //! default parameters: no checkpoints
+  const Parameters DEFAULT_PARAMETERS = {"", 16384, false};
+  //! finished tiles of a tiled computation
+  struct Checkpoint {
+    std::string filename;
+    //! tiles are written to the file
+    bool enabled;
+    //! finished tiles
+    std::vector<bool> done;
+    //! results of tiles read from an existing checkpoint
+    std::vector<std::vector<uint64_t>> values;
+  };
+  //! 64-bit FNV-1a hash of given bytes, chained via 'hash'
+  uint64_t
+  fingerprint(const void* data,
+              const std::size_t n_bytes,
+              uint64_t hash = 14695981039346656037ULL);
+  //! open checkpoint for tiles with given numbers of result values.
+  //! with 'resume', finished tiles of an existing checkpoint file (with the
+  //! same fingerprint) are read, else the file is created anew. records with
+  //! other numbers of values are discarded as corrupt.
+  //! with an empty filename, tiles are not saved.
+  Checkpoint
+  open_checkpoint(const Parameters& params,
+                  const std::string kind,
+                  const std::vector<std::size_t>& n_tile_values,
+                  const uint64_t fingerprint);
+  //! append results of finished tile to checkpoint file
+  void
+  save_tile(Checkpoint& checkpoint,
+            const std::size_t i_tile,
+            const std::vector<uint64_t>& values);
+  //! 32-bit float stored as tile value
+  uint64_t
+  float_value(const float f);
+  //! float from tile value
+  float
+  value_float(const uint64_t v);
+} // end namespace Tiles
+} // end namespace Density
+} // end namespace Clustering
+
@@ -0,0 +1,34 @@
+#!/bin/sh
+# regression check: populations of box-based engines must not depend
+# on the number of box dimensions, even for data on a regular grid
+# where many pairs lie at exactly the radius and box coordinates are
+# prone to rounding. reference: 'gemm' engine (all frame pairs).
+#
+# usage: box_dims_quantized.sh PATH_TO_CLUSTERING_BINARY
+
+CLUSTERING="$1"
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+cd "$WORKDIR" || exit 1
+
+# lattice with 0.1 spacing and minima off zero
+awk 'BEGIN {
+  for (a=0; a < 25; ++a) for (b=0; b < 7; ++b) for (c=0; c < 7; ++c) {
+    printf "%.1f %.1f %.1f %.1f\n", 0.6 + a/10, 0.9 + b/10, 1.1 + c/10, 1.2 + (b+c)%5/10
+  }
+}' > coords.txt
+
+"$CLUSTERING" density -f coords.txt -R 0.2 0.3 -p ref --population-engine gemm > /dev/null || exit 1
+status=0
+for engine in boxes profile; do
+  for dims in 1 2 3 4; do
+    "$CLUSTERING" density -f coords.txt -R 0.2 0.3 -p pop --population-engine $engine --box-dims $dims > /dev/null || exit 1
+    for r in 0.200000 0.300000; do
+      if ! cmp -s ref_$r pop_$r; then
+        echo "populations differ: engine '$engine', box-dims $dims, radius $r"
+        status=1
+      fi
+    done
+  done
+done
+exit $status
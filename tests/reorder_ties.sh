@@ -0,0 +1,68 @@
+#!/bin/sh
+# regression check: nearest neighbors and screening must not depend on the
+# frame order of space-filling curve reordering, even for data on a regular grid
+# (with duplicate frames) where many neighbors lie at exactly the same
+# distance. reference: brute-force search without reordering.
+#
+# usage: reorder_ties.sh PATH_TO_CLUSTERING_BINARY
+
+CLUSTERING="$1"
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+cd "$WORKDIR" || exit 1
+
+# lattice with 0.1 spacing, first frames duplicated
+awk 'BEGIN {
+  for (a=0; a < 25; ++a) for (b=0; b < 7; ++b) for (c=0; c < 7; ++c) {
+    printf "%.1f %.1f %.1f %.1f\n", 0.6 + a/10, 0.9 + b/10, 1.1 + c/10, 1.2 + (b+c)%5/10
+  }
+}' > lattice.txt
+(cat lattice.txt; head -n 300 lattice.txt) > coords.txt
+
+"$CLUSTERING" density -f coords.txt -r 0.3 -d fe > /dev/null || exit 1
+"$CLUSTERING" density -f coords.txt -r 0.3 -D fe -b ref --nn-engine brute > /dev/null || exit 1
+status=0
+for engine in brute kdtree incremental gemm; do
+  for curve in morton hilbert; do
+    "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -b nn --nn-engine $engine --reorder $curve --reorder-dims 4 > /dev/null || exit 1
+    if ! cmp -s ref nn; then
+      echo "nearest neighbors differ: engine '$engine', reorder '$curve'"
+      status=1
+    fi
+  done
+done
+for filter in --prefilter --partial-distances; do
+  "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -b nn --nn-engine brute $filter --reorder hilbert --reorder-dims 4 > /dev/null || exit 1
+  if ! cmp -s ref nn; then
+    echo "nearest neighbors differ: engine 'brute' with '$filter', reorder 'hilbert'"
+    status=1
+  fi
+done
+# screening: frames of equal free energy must be handled in original order,
+# such that cluster names do not depend on the reordering either.
+for engine in sweep components; do
+  "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -T 0.1 0.1 2.7 -o cl_ref --screening-engine $engine > /dev/null || exit 1
+  for curve in morton hilbert; do
+    "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -T 0.1 0.1 2.7 -o cl --screening-engine $engine --reorder $curve --reorder-dims 4 > /dev/null || exit 1
+    for f in cl_ref.*; do
+      if ! cmp -s $f cl${f#cl_ref}; then
+        echo "screening differs: engine '$engine', reorder '$curve', file '$f'"
+        status=1
+      fi
+    done
+  done
+done
+# screening from initial states and assignment of low density frames
+"$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -T 1.6 0.1 2.7 -i cl_ref.1.50 -o it_ref > /dev/null || exit 1
+"$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -i cl_ref.1.50 -o as_ref > /dev/null || exit 1
+for curve in morton hilbert; do
+  "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -T 1.6 0.1 2.7 -i cl_ref.1.50 -o it --reorder $curve --reorder-dims 4 > /dev/null || exit 1
+  "$CLUSTERING" density -f coords.txt -r 0.3 -D fe -B ref -i cl_ref.1.50 -o as --reorder $curve --reorder-dims 4 > /dev/null || exit 1
+  for f in it_ref.* as_ref; do
+    if ! cmp -s $f ${f%%_ref*}${f#*_ref}; then
+      echo "clustering from initial states differs: reorder '$curve', file '$f'"
+      status=1
+    fi
+  done
+done
+exit $status
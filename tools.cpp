@@ -26,6 +26,7 @@ EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tools.hpp"
 
 #include <cmath>
+#include <algorithm>
 #include <stdarg.h>
 
 namespace Clustering {
@@ -128,7 +129,6 @@ read_neighborhood(const std::string fname) {
     std::cerr << "error: cannot open file '" << fname << "' for reading." << std::endl;
     exit(EXIT_FAILURE);
   } else {
-    std::size_t i=0;
     while (ifs.good()) {
       std::size_t buf1;
       float buf2;
@@ -139,9 +139,8 @@ read_neighborhood(const std::string fname) {
       ifs >> buf3;
       ifs >> buf4;
       if ( ! ifs.fail()) {
-        nh[i] = std::pair<std::size_t, float>(buf1, buf2);
-        nh_high_dens[i] = std::pair<std::size_t, float>(buf3, buf4);
-        ++i;
+        nh.push_back(buf1, buf2);
+        nh_high_dens.push_back(buf3, buf4);
       }
     }
   }
@@ -153,19 +152,52 @@ write_neighborhood(const std::string fname,
                    const Neighborhood& nh,
                    const Neighborhood& nh_high_dens) {
   std::ofstream ofs(fname);
-  auto p = nh.begin();
-  auto p_hd = nh_high_dens.begin();
-  while (p != nh.end() && p_hd != nh_high_dens.end()) {
-    // first: key (not used)
-    // second: neighbor
-    // second.first: id; second.second: squared dist
-    ofs << p->second.first    << " " << p->second.second    << " "
-        << p_hd->second.first << " " << p_hd->second.second << "\n";
-    ++p;
-    ++p_hd;
+  std::size_t n = std::min(nh.size(), nh_high_dens.size());
+  for (std::size_t i=0; i < n; ++i) {
+    ofs << nh.ids[i]           << " " << nh.dist2[i]           << " "
+        << nh_high_dens.ids[i] << " " << nh_high_dens.dist2[i] << "\n";
   }
 }
 
+Neighborhood
+reordered(const Neighborhood& nh
+        , const std::vector<std::size_t>& order) {
+  if (order.empty()) {
+    return nh;
+  }
+  // new id of frame i: position[i]
+  std::vector<std::size_t> position(order.size());
+  for (std::size_t i=0; i < order.size(); ++i) {
+    position[order[i]] = i;
+  }
+  Neighborhood nh_reordered(nh.size(), 0, 0.0f);
+  for (std::size_t i=0; i < nh.size(); ++i) {
+    std::size_t neighbor_id = nh.ids[i];
+    if (neighbor_id < order.size()) {
+      neighbor_id = position[neighbor_id];
+    }
+    nh_reordered.set(position[i], neighbor_id, nh.dist2[i]);
+  }
+  return nh_reordered;
+}
+
+Neighborhood
+original_order(const Neighborhood& nh
+             , const std::vector<std::size_t>& order) {
+  if (order.empty()) {
+    return nh;
+  }
+  Neighborhood nh_original(nh.size(), 0, 0.0f);
+  for (std::size_t i=0; i < nh.size(); ++i) {
+    std::size_t neighbor_id = nh.ids[i];
+    if (neighbor_id < order.size()) {
+      neighbor_id = order[neighbor_id];
+    }
+    nh_original.set(order[i], neighbor_id, nh.dist2[i]);
+  }
+  return nh_original;
+}
+
 std::map<std::size_t, std::size_t>
 microstate_populations(std::vector<std::size_t> traj) {
   std::map<std::size_t, std::size_t> populations;
@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <map>
 #include <tuple>
 #include <memory>
@@ -52,8 +53,42 @@ namespace Clustering {
 namespace Tools {
   //! matches neighbor's frame id to distance
   using Neighbor = std::pair<std::size_t, float>;
-  //! map frame id to neighbors
-  using Neighborhood = std::map<std::size_t, Clustering::Tools::Neighbor>;
+  //! nearest neighbor of every frame as contiguous table,
+  //! i.e. neighbor's frame id and squared distance indexed by frame id.
+  struct Neighborhood {
+    //! frame ids of neighbors
+    std::vector<uint32_t> ids;
+    //! squared distances to neighbors
+    std::vector<float> dist2;
+    Neighborhood() = default;
+    //! table of given number of frames, all with the same neighbor
+    Neighborhood(std::size_t n_frames, std::size_t id, float d2)
+      : ids(n_frames, id)
+      , dist2(n_frames, d2) {
+    }
+    //! number of frames
+    std::size_t
+    size() const {
+      return ids.size();
+    }
+    //! set neighbor of frame i
+    void
+    set(std::size_t i, std::size_t id, float d2) {
+      ids[i] = id;
+      dist2[i] = d2;
+    }
+    //! append neighbor of next frame
+    void
+    push_back(std::size_t id, float d2) {
+      ids.push_back(id);
+      dist2.push_back(d2);
+    }
+    //! neighbor of frame i
+    Neighbor
+    operator[](std::size_t i) const {
+      return Neighbor(ids[i], dist2[i]);
+    }
+  };
   //! write populations as column into given file
   void
   write_pops(std::string fname, std::vector<std::size_t> pops);
@@ -106,6 +141,36 @@ namespace Tools {
   template <typename NUM>
   void
   free_coords(NUM* coords);
+  //! copy of coordinates with rows in given order, i.e. row i of the
+  //! copy is row order[i] of the original.
+  //! memory is allocated like in read_coords (free with free_coords).
+  template <typename NUM>
+  NUM*
+  reordered_coords(const NUM* coords
+                 , std::size_t n_rows
+                 , std::size_t n_cols
+                 , const std::vector<std::size_t>& order);
+  //! values in given order, i.e. result[i] = values[order[i]].
+  //! an empty order (or empty values) leaves the values unchanged.
+  template <typename T>
+  std::vector<T>
+  reordered(const std::vector<T>& values
+          , const std::vector<std::size_t>& order);
+  //! inverse of 'reordered', i.e. result[order[i]] = values[i].
+  template <typename T>
+  std::vector<T>
+  original_order(const std::vector<T>& values
+               , const std::vector<std::size_t>& order);
+  //! neighborhood with frames in given order, i.e. frame ids and neighbor ids
+  //! are renumbered. ids of non-existing neighbors (>= number of frames) are kept.
+  //! an empty order leaves the neighborhood unchanged.
+  Neighborhood
+  reordered(const Neighborhood& nh
+          , const std::vector<std::size_t>& order);
+  //! inverse of 'reordered' for neighborhoods.
+  Neighborhood
+  original_order(const Neighborhood& nh
+               , const std::vector<std::size_t>& order);
   //! return std::vector with coords sorted along first dimension.
   //! uses row-based addressing (row*n_cols+col).
   template <typename NUM>
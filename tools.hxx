@@ -109,6 +109,49 @@ free_coords(NUM* coords) {
   _mm_free(coords);
 }
 
+template <typename NUM>
+NUM*
+reordered_coords(const NUM* coords
+               , std::size_t n_rows
+               , std::size_t n_cols
+               , const std::vector<std::size_t>& order) {
+  NUM* sorted_coords = (NUM*) _mm_malloc(sizeof(NUM)*n_rows*n_cols, DC_MEM_ALIGNMENT);
+  for (std::size_t i=0; i < n_rows; ++i) {
+    std::copy(&coords[order[i]*n_cols]
+            , &coords[order[i]*n_cols] + n_cols
+            , &sorted_coords[i*n_cols]);
+  }
+  return sorted_coords;
+}
+
+template <typename T>
+std::vector<T>
+reordered(const std::vector<T>& values
+        , const std::vector<std::size_t>& order) {
+  if (order.empty() || values.empty()) {
+    return values;
+  }
+  std::vector<T> result(order.size());
+  for (std::size_t i=0; i < order.size(); ++i) {
+    result[i] = values[order[i]];
+  }
+  return result;
+}
+
+template <typename T>
+std::vector<T>
+original_order(const std::vector<T>& values
+             , const std::vector<std::size_t>& order) {
+  if (order.empty() || values.empty()) {
+    return values;
+  }
+  std::vector<T> result(order.size());
+  for (std::size_t i=0; i < order.size(); ++i) {
+    result[order[i]] = values[i];
+  }
+  return result;
+}
+
 template <typename NUM>
 std::vector<NUM>
 dim1_sorted_coords(const NUM* coords